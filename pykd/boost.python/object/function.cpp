@@ -25,6 +25,8 @@
 
 #include <algorithm>
 #include <cstring>
+#include <map>
+#include <string>
 
 #if BOOST_PYTHON_DEBUG_ERROR_MESSAGES
 # include <cstdio>
@@ -116,8 +118,34 @@ function::function(
     );
 }
 
+namespace
+{
+  // The docstrings of the defs are kept as native strings and converted to
+  // Python strings when __doc__ of a function is requested the first time:
+  // no Python objects are created for them at import. The signature generator
+  // compares the docs of the overloads, so all pending docs are converted at
+  // once. The map is never destroyed: functions may outlive static objects
+  typedef std::map<function*, std::string> pending_doc_map;
+
+  pending_doc_map& pending_docs()
+  {
+      static pending_doc_map* docs = new pending_doc_map;
+      return *docs;
+  }
+
+  void convert_pending_docs()
+  {
+      pending_doc_map docs;
+      docs.swap(pending_docs());
+
+      for (pending_doc_map::iterator it = docs.begin(); it != docs.end(); ++it)
+          it->first->doc(str(it->second.c_str(), it->second.size()));
+  }
+}
+
 function::~function()
 {
+    pending_docs().erase(this);
 }
 
 PyObject* function::call(PyObject* args, PyObject* keywords) const
@@ -325,7 +353,13 @@ void function::add_overload(handle<function> const& overload_)
 
     // If we have no documentation, get the docs from the overload
     if (!m_doc)
+    {
         m_doc = overload_->m_doc;
+
+        pending_doc_map::const_iterator pending = pending_docs().find(overload_.get());
+        if (pending != pending_docs().end() && pending_docs().find(this) == pending_docs().end())
+            pending_docs()[this] = pending->second;
+    }
 }
 
 namespace
@@ -532,23 +566,35 @@ void function::add_to_namespace(
           "C++ signature:", f->signature(true)));
     }
     */
-    str _doc;
+    // Only the tags are stored here, signatures are generated by function_get_doc
+    // on demand. The string is assembled natively: it is done for every def at import,
+    // the Python string is created on the first request
+    std::string _doc;
 
     if (docstring_options::show_py_signatures_)
     {
-        _doc += str(const_cast<const char*>(detail::py_signature_tag));
+        _doc += detail::py_signature_tag;
     }
     if (doc != 0 && docstring_options::show_user_defined_)
         _doc += doc;
 
     if (docstring_options::show_cpp_signatures_)
     {
-        _doc += str(const_cast<const char*>(detail::cpp_signature_tag));
+        _doc += detail::cpp_signature_tag;
     }
-    if(_doc)
+    if(!_doc.empty())
     {    
-        object mutable_attribute(attribute);
-        mutable_attribute.attr("__doc__")= _doc;
+        if (attribute.ptr()->ob_type == &function_type)
+        {
+            function* f = downcast<function>(attribute.ptr());
+            f->doc(object());
+            pending_docs()[f] = _doc;
+        }
+        else
+        {
+            object mutable_attribute(attribute);
+            mutable_attribute.attr("__doc__")= str(_doc.c_str(), _doc.size());
+        }
     }
 }
 
@@ -633,6 +679,7 @@ extern "C"
     static PyObject* function_get_doc(PyObject* op, void*)
     {
         function* f = downcast<function>(op);
+        convert_pending_docs();
         list signatures = function_doc_signature_generator::function_doc_signatures(f);
         if(!signatures) return python::detail::none();
         signatures.reverse();
@@ -642,6 +689,7 @@ extern "C"
     static int function_set_doc(PyObject* op, PyObject* doc, void*)
     {
         function* f = downcast<function>(op);
+        pending_docs().erase(f);
         f->doc(doc ? object(python::detail::borrowed_reference(doc)) : object());
         return 0;
     }
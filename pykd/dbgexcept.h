@@ -41,6 +41,14 @@ public:
     {}
 };
 
+class CancelledException : public std::exception
+{
+public:
+
+    CancelledException(const char* desc) : std::exception(desc)
+    {}
+};
+
 template< class TExcept >
 struct exceptPyType{
     static python::handle<>     pyExceptType;
@@ -137,6 +145,12 @@ inline void pykdExceptionTranslate(const std::exception &e)
         PyErr_SetString(PyExc_KeyError, e.what());
         return;
     }
+
+    if (typeid(e).hash_code() == typeid(CancelledException).hash_code())
+    {
+        PyErr_SetString(PyExc_KeyboardInterrupt, e.what());
+        return;
+    }
 }
 
 inline void registerExceptions()
@@ -153,6 +167,7 @@ inline void registerExceptions()
     python::register_exception_translator<AttributeException>(&pykdExceptionTranslate);
     python::register_exception_translator<StopIteration>(&pykdExceptionTranslate);
     python::register_exception_translator<KeyException>(&pykdExceptionTranslate);
+    python::register_exception_translator<CancelledException>(&pykdExceptionTranslate);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////
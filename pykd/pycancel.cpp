@@ -0,0 +1,44 @@
+#include "stdafx.h"
+
+#include <sstream>
+
+#include "pycancel.h"
+#include "pydbgio.h"
+
+namespace pykd {
+
+///////////////////////////////////////////////////////////////////////////////
+
+std::atomic<bool>  g_cancelRequested( false );
+
+///////////////////////////////////////////////////////////////////////////////
+
+// guarded by the GIL
+static unsigned long long  g_progressPercent = ~0ULL;
+static std::wstring  g_progressText;
+
+void setProgress( unsigned long long done, unsigned long long total, const std::wstring& text )
+{
+    checkCancel();
+
+    unsigned long long  percent = total != 0 ? ( done < total ? done * 100 / total : 100 ) : 0;
+
+    if ( percent == g_progressPercent && text == g_progressText )
+        return;
+
+    g_progressPercent = percent;
+    g_progressText = text;
+
+    std::wstringstream  sstr;
+
+    if ( !text.empty() )
+        sstr << text << L": ";
+
+    sstr << done << L'/' << total << L" (" << percent << L"%)";
+
+    setStatusMessage( sstr.str() );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+} // end namespace pykd
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+
+#include "dbgexcept.h"
+
+namespace pykd {
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Cooperative cancellation of the running script. The request is a flag which
+// may be set from any thread (the CTRL+BREAK watch); long native loops poll it
+// with checkCancel and unwind with CancelledException (KeyboardInterrupt in
+// Python). The request is consumed when it is delivered, so a script catching
+// KeyboardInterrupt (or the next console statement) runs on. The flag is also
+// cleared when !py starts a script or the console
+
+extern std::atomic<bool>  g_cancelRequested;
+
+inline bool isCancelRequested()
+{
+    return g_cancelRequested.load( std::memory_order_relaxed );
+}
+
+inline void checkCancel()
+{
+    if ( isCancelRequested() && g_cancelRequested.exchange( false ) )
+        throw CancelledException("script is cancelled");
+}
+
+inline void requestCancel()
+{
+    g_cancelRequested = true;
+}
+
+inline void resetCancel()
+{
+    g_cancelRequested = false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Show "text: done/total (N%)" at the windbg status bar. The status bar is
+// updated only when the percent or the text changes, so it may be called on
+// each iteration of a script loop. It is a cancellation point as well
+
+void setProgress( unsigned long long done, unsigned long long total, const std::wstring& text = L"" );
+
+///////////////////////////////////////////////////////////////////////////////
+
+} // end namespace pykd
@@ -0,0 +1,367 @@
+#include "stdafx.h"
+
+#include <algorithm>
+#include <map>
+
+#include <boost/python/extract.hpp>
+
+#include "kdlib/exceptions.h"
+#include "kdlib/memaccess.h"
+
+#include "pycoverage.h"
+#include "pycancel.h"
+
+namespace pykd {
+
+///////////////////////////////////////////////////////////////////////////////
+
+CodeCoverage::CodeCoverage( const std::vector<kdlib::MEMOFFSET_64>& addresses ) :
+    m_addresses( addresses )
+{
+    std::sort( m_addresses.begin(), m_addresses.end() );
+    m_addresses.erase( std::unique( m_addresses.begin(), m_addresses.end() ), m_addresses.end() );
+
+    m_bitmap.resize( ( m_addresses.size() + 7 ) / 8 );
+    m_hitOrder.reserve( m_addresses.size() );
+
+    m_points.reserve( m_addresses.size() );
+
+    try {
+
+        for ( size_t i = 0; i < m_addresses.size(); ++i )
+        {
+            PointPtr  point( new Point( this, i ) );
+            point->m_breakpoint = kdlib::softwareBreakPointSet( m_addresses[i], point.get() );
+            m_points.push_back( point );
+        }
+    }
+    catch (const kdlib::DbgException&)
+    {
+        removeBreakpoints();
+        throw;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+CodeCoverage::~CodeCoverage()
+{
+    AutoRestorePyState  pystate;
+    removeBreakpoints();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+kdlib::DebugCallbackResult CodeCoverage::Point::onHit()
+{
+    boost::mutex::scoped_lock  lock( m_coverage->m_lock );
+
+    // the breakpoint stays until the target stops
+    if ( m_coverage->isHit( m_index ) )
+        return kdlib::DebugCallbackProceed;
+
+    m_coverage->m_bitmap[m_index / 8] |= 1 << ( m_index % 8 );
+    m_coverage->m_hitOrder.push_back( static_cast<unsigned long>( m_index ) );
+    m_coverage->m_hitPoints.push_back( m_index );
+
+    return kdlib::DebugCallbackProceed;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void CodeCoverage::Point::onRemove()
+{
+    boost::mutex::scoped_lock  lock( m_coverage->m_lock );
+    m_breakpoint = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void CodeCoverage::onExecutionStatusChange( kdlib::ExecutionStatus executionStatus )
+{
+    if ( executionStatus == kdlib::DebugStatusBreak || executionStatus == kdlib::DebugStatusNoDebuggee )
+        removeHitBreakpoints();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void CodeCoverage::stop()
+{
+    AutoRestorePyState  pystate;
+    removeBreakpoints();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void CodeCoverage::removeBreakpoint( size_t index )
+{
+    kdlib::BreakpointPtr  bp;
+
+    do {
+        boost::mutex::scoped_lock  lock( m_lock );
+        bp = m_points[index]->m_breakpoint;
+        m_points[index]->m_breakpoint = 0;
+    } while(false);
+
+    if ( !bp )
+        return;
+
+    // the engine calls onRemove, the lock is not held
+    try {
+        bp->remove();
+    }
+    catch (const kdlib::DbgException&)
+    {}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void CodeCoverage::removeBreakpoints()
+{
+    do {
+        boost::mutex::scoped_lock  lock( m_lock );
+        m_hitPoints.clear();
+    } while(false);
+
+    for ( size_t i = 0; i < m_points.size(); ++i )
+        removeBreakpoint( i );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void CodeCoverage::removeHitBreakpoints()
+{
+    std::vector<size_t>  hitPoints;
+
+    do {
+        boost::mutex::scoped_lock  lock( m_lock );
+        hitPoints.swap( m_hitPoints );
+    } while(false);
+
+    for ( size_t i = 0; i < hitPoints.size(); ++i )
+        removeBreakpoint( hitPoints[i] );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::list CodeCoverage::getAddresses()
+{
+    python::list  lst;
+    for ( size_t i = 0; i < m_addresses.size(); ++i )
+        lst.append( m_addresses[i] );
+    return lst;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+size_t CodeCoverage::getHitCount()
+{
+    AutoRestorePyState  pystate;
+    boost::mutex::scoped_lock  lock(m_lock);
+    return m_hitOrder.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::list CodeCoverage::getAddressesByHit( bool hit )
+{
+    std::vector<kdlib::MEMOFFSET_64>  addresses;
+
+    do {
+
+        AutoRestorePyState  pystate;
+        boost::mutex::scoped_lock  lock(m_lock);
+
+        for ( size_t i = 0; i < m_addresses.size(); ++i )
+        {
+            if ( isHit(i) == hit )
+                addresses.push_back( m_addresses[i] );
+        }
+
+    } while(false);
+
+    python::list  lst;
+    for ( size_t i = 0; i < addresses.size(); ++i )
+        lst.append( addresses[i] );
+
+    return lst;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::list CodeCoverage::getHits()
+{
+    return getAddressesByHit( true );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::list CodeCoverage::getMissed()
+{
+    return getAddressesByHit( false );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::object CodeCoverage::getBitmap()
+{
+    std::vector<unsigned char>  bitmap;
+
+    do {
+        AutoRestorePyState  pystate;
+        boost::mutex::scoped_lock  lock(m_lock);
+        bitmap = m_bitmap;
+    } while(false);
+
+    const char*  data = bitmap.empty() ? "" : reinterpret_cast<const char*>( &bitmap[0] );
+
+    return python::object( python::handle<>( PyByteArray_FromStringAndSize( data, bitmap.size() ) ) );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::object CodeCoverage::getHitOrder()
+{
+    std::vector<unsigned long>  hitOrder;
+
+    do {
+        AutoRestorePyState  pystate;
+        boost::mutex::scoped_lock  lock(m_lock);
+        hitOrder = m_hitOrder;
+    } while(false);
+
+    const char*  data = hitOrder.empty() ? "" : reinterpret_cast<const char*>( &hitOrder[0] );
+
+    return python::object( python::handle<>( PyByteArray_FromStringAndSize( data, hitOrder.size() * sizeof(unsigned long) ) ) );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+CodeCoveragePtr startCoverage( const python::list& addresses )
+{
+    std::vector<kdlib::MEMOFFSET_64>  offsets;
+    for ( long i = 0; i < python::len(addresses); ++i )
+        offsets.push_back( python::extract<kdlib::MEMOFFSET_64>( addresses[i] ) );
+
+    AutoRestorePyState  pystate;
+    return CodeCoveragePtr( new CodeCoverage( offsets ) );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+typedef std::vector< std::pair<kdlib::MEMOFFSET_64, kdlib::MEMOFFSET_64> >  CodeRanges;
+
+// Executable sections of the module image, empty if the headers are not
+// readable (a dump without them)
+CodeRanges getCodeRanges( kdlib::Module& module )
+{
+    CodeRanges  ranges;
+
+    kdlib::MEMOFFSET_64  base = module.getBase();
+
+    try {
+
+        if ( kdlib::ptrWord( base ) != IMAGE_DOS_SIGNATURE )
+            return ranges;
+
+        kdlib::MEMOFFSET_64  ntHeaders = base + kdlib::ptrDWord( base + offsetof(IMAGE_DOS_HEADER, e_lfanew) );
+        if ( kdlib::ptrDWord( ntHeaders ) != IMAGE_NT_SIGNATURE )
+            return ranges;
+
+        // the file header is the same in the 32 and 64 bit images
+        unsigned short  sectionCount = kdlib::ptrWord( ntHeaders + offsetof(IMAGE_NT_HEADERS32, FileHeader.NumberOfSections) );
+        unsigned short  optionalHeaderSize = kdlib::ptrWord( ntHeaders + offsetof(IMAGE_NT_HEADERS32, FileHeader.SizeOfOptionalHeader) );
+
+        kdlib::MEMOFFSET_64  sections = ntHeaders + offsetof(IMAGE_NT_HEADERS32, OptionalHeader) + optionalHeaderSize;
+
+        std::vector<unsigned char>  headers = kdlib::loadBytes( sections, sectionCount * sizeof(IMAGE_SECTION_HEADER) );
+
+        for ( unsigned short i = 0; i < sectionCount; ++i )
+        {
+            const IMAGE_SECTION_HEADER*  section = reinterpret_cast<const IMAGE_SECTION_HEADER*>( &headers[i * sizeof(IMAGE_SECTION_HEADER)] );
+            if ( section->Characteristics & IMAGE_SCN_MEM_EXECUTE )
+                ranges.push_back( std::make_pair( base + section->VirtualAddress, base + section->VirtualAddress + section->Misc.VirtualSize ) );
+        }
+    }
+    catch (const kdlib::DbgException&)
+    {
+        ranges.clear();
+    }
+
+    std::sort( ranges.begin(), ranges.end() );
+    return ranges;
+}
+
+bool isInRanges( const CodeRanges& ranges, kdlib::MEMOFFSET_64 offset )
+{
+    CodeRanges::const_iterator  it = std::upper_bound( ranges.begin(), ranges.end(), std::make_pair( offset, ~0ULL ) );
+    if ( it == ranges.begin() )
+        return false;
+
+    --it;
+    return offset < it->second;
+}
+
+bool isExecutableProtect( kdlib::MemoryProtect protect )
+{
+    return protect == kdlib::PageExecute || protect == kdlib::PageExecuteRead ||
+        protect == kdlib::PageExecuteReadWrite || protect == kdlib::PageExecuteWriteCopy;
+}
+
+} // anonymous namespace
+
+///////////////////////////////////////////////////////////////////////////////
+
+CodeCoveragePtr startFunctionCoverage( kdlib::Module& module )
+{
+    AutoRestorePyState  pystate;
+
+    kdlib::SymbolOffsetList  symbols = module.enumSymbols( L"*" );
+
+    // functions are told from data by the address: they are placed in the
+    // executable sections. Without the image headers the page protection is
+    // asked, once per page
+    CodeRanges  codeRanges = getCodeRanges( module );
+
+    std::map<kdlib::MEMOFFSET_64, bool>  executablePages;
+
+    std::vector<kdlib::MEMOFFSET_64>  offsets;
+
+    for ( kdlib::SymbolOffsetList::const_iterator it = symbols.begin(); it != symbols.end(); ++it )
+    {
+        checkCancel();
+
+        if ( !codeRanges.empty() )
+        {
+            if ( isInRanges( codeRanges, it->second ) )
+                offsets.push_back( it->second );
+            continue;
+        }
+
+        kdlib::MEMOFFSET_64  page = it->second & ~0xFFFULL;
+
+        std::map<kdlib::MEMOFFSET_64, bool>::iterator  pageIt = executablePages.find( page );
+        if ( pageIt == executablePages.end() )
+        {
+            bool  executable = false;
+            try {
+                executable = isExecutableProtect( kdlib::getVaProtect( page ) );
+            }
+            catch (const kdlib::DbgException&)
+            {}
+
+            pageIt = executablePages.insert( std::make_pair( page, executable ) ).first;
+        }
+
+        if ( pageIt->second )
+            offsets.push_back( it->second );
+    }
+
+    return CodeCoveragePtr( new CodeCoverage( offsets ) );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+} // end namespace pykd
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/python/list.hpp>
+namespace python = boost::python;
+
+#include "kdlib/dbgengine.h"
+#include "kdlib/breakpoint.h"
+#include "kdlib/eventhandler.h"
+#include "kdlib/module.h"
+
+#include "pythreadstate.h"
+
+namespace pykd {
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Code coverage with one-shot software breakpoints. A hit sets the address bit
+// in the bitmap, appends the address index to the hit order and queues the
+// breakpoint, Python is never called. A breakpoint can not be removed from its
+// own hit callback, the queued ones are removed when the target stops; until
+// then their hits are ignored. Addresses are sorted and bit N of the bitmap
+// stands for the N-th address. Remaining breakpoints are removed when the
+// object is deleted or stopped
+
+class CodeCoverage : private kdlib::EventHandler, private boost::noncopyable
+{
+
+public:
+
+    explicit CodeCoverage( const std::vector<kdlib::MEMOFFSET_64>& addresses );
+
+    ~CodeCoverage();
+
+    size_t getAddressCount() const {
+        return m_addresses.size();
+    }
+
+    python::list getAddresses();
+
+    size_t getHitCount();
+
+    python::list getHits();
+
+    python::list getMissed();
+
+    python::object getBitmap();
+
+    python::object getHitOrder();
+
+    void stop();
+
+private:
+
+    class Point : public kdlib::BreakpointCallback
+    {
+    public:
+
+        Point( CodeCoverage* coverage, size_t index ) :
+            m_coverage( coverage ),
+            m_index( index )
+        {}
+
+        virtual kdlib::DebugCallbackResult onHit();
+
+        virtual void onRemove();
+
+        CodeCoverage*  m_coverage;
+        size_t  m_index;
+        kdlib::BreakpointPtr  m_breakpoint;
+    };
+
+    typedef boost::shared_ptr<Point>  PointPtr;
+
+    bool isHit( size_t index ) const {
+        return ( m_bitmap[index / 8] & ( 1 << ( index % 8 ) ) ) != 0;
+    }
+
+    python::list getAddressesByHit( bool hit );
+
+    void onExecutionStatusChange( kdlib::ExecutionStatus executionStatus ) override;
+
+    void removeBreakpoints();
+
+    void removeHitBreakpoints();
+
+    void removeBreakpoint( size_t index );
+
+    std::vector<kdlib::MEMOFFSET_64>  m_addresses;
+
+    std::vector<PointPtr>  m_points;
+
+    boost::mutex  m_lock;
+
+    std::vector<unsigned char>  m_bitmap;
+
+    std::vector<unsigned long>  m_hitOrder;
+
+    // hit points with the breakpoint not removed yet
+    std::vector<size_t>  m_hitPoints;
+};
+
+typedef boost::shared_ptr<CodeCoverage>  CodeCoveragePtr;
+
+CodeCoveragePtr startCoverage( const python::list& addresses );
+
+CodeCoveragePtr startFunctionCoverage( kdlib::Module& module );
+
+///////////////////////////////////////////////////////////////////////////////
+
+} // end namespace pykd
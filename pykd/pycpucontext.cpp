@@ -1,6 +1,14 @@
 
 #include "stdafx.h"
 
+#include <algorithm>
+#include <map>
+
+#include <comutil.h>
+#include <dbgeng.h>
+
+#include <boost/thread/mutex.hpp>
+
 #include "pycpucontext.h"
 #include "variant.h"
 
@@ -89,6 +97,124 @@ python::list getStack(bool inlineFrames)
 
 ///////////////////////////////////////////////////////////////////////////////
 
+StackTablePtr getStackTable(bool inlineFrames)
+{
+    AutoRestorePyState  pystate;
+    return StackTablePtr( new StackTable( kdlib::getStack(inlineFrames) ) );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+StackTable::StackTable( const kdlib::StackPtr& stack )
+{
+    unsigned long  numberFrames = stack->getFrameCount();
+
+    m_regs.resize(numberFrames);
+    m_frames.resize(numberFrames);
+
+    for ( unsigned long i = 0; i < numberFrames; ++i )
+    {
+        kdlib::StackFramePtr  frame = stack->getFrame(i);
+        m_frames[i] = frame;
+        m_regs[i].ip = frame->getIP();
+        m_regs[i].ret = frame->getRET();
+        m_regs[i].sp = frame->getSP();
+        m_regs[i].fp = frame->getFP();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+size_t StackTable::checkIndex( long index ) const
+{
+    long  count = static_cast<long>( m_regs.size() );
+
+    if ( index < 0 )
+        index += count;
+
+    if ( index < 0 || index >= count )
+        throw kdlib::IndexException(index);
+
+    return static_cast<size_t>(index);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+kdlib::StackFramePtr StackTable::getFrame( long index )
+{
+    return m_frames[ checkIndex(index) ];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::list StackTable::getIPs()
+{
+    python::list  lst;
+    for ( size_t i = 0; i < m_regs.size(); ++i )
+        lst.append( m_regs[i].ip );
+    return lst;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::list StackTable::getRETs()
+{
+    python::list  lst;
+    for ( size_t i = 0; i < m_regs.size(); ++i )
+        lst.append( m_regs[i].ret );
+    return lst;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::list StackTable::getSPs()
+{
+    python::list  lst;
+    for ( size_t i = 0; i < m_regs.size(); ++i )
+        lst.append( m_regs[i].sp );
+    return lst;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::list StackTable::getFPs()
+{
+    python::list  lst;
+    for ( size_t i = 0; i < m_regs.size(); ++i )
+        lst.append( m_regs[i].fp );
+    return lst;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::list StackTable::getTable()
+{
+    python::list  lst;
+    for ( size_t i = 0; i < m_regs.size(); ++i )
+        lst.append( python::make_tuple( m_regs[i].ip, m_regs[i].ret, m_regs[i].sp, m_regs[i].fp ) );
+    return lst;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+std::wstring StackTable::print()
+{
+    std::wstringstream  sstr;
+
+    for ( size_t i = 0; i < m_regs.size(); ++i )
+    {
+        sstr << std::dec << i << L"  ";
+        sstr << L"IP=" << std::hex << m_regs[i].ip << L"  ";
+        sstr << L"Return=" << std::hex << m_regs[i].ret << L"  ";
+        sstr << L"Frame Offset=" << std::hex << m_regs[i].fp << L"  ";
+        sstr << L"Stack Offset=" << std::hex << m_regs[i].sp << std::endl;
+    }
+
+    return sstr.str();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 std::wstring StackFrameAdapter::print( kdlib::StackFramePtr& frame )
 {
     AutoRestorePyState  pystate;
@@ -104,140 +230,248 @@ std::wstring StackFrameAdapter::print( kdlib::StackFramePtr& frame )
 }
 ///////////////////////////////////////////////////////////////////////////////
 
-python::list StackFrameAdapter::getParamsList( kdlib::StackFramePtr&  frame)
+FrameVarsList StackFrameAdapter::getParamsList( kdlib::StackFramePtr&  frame)
 {
-    typedef std::vector< std::pair< std::wstring, kdlib::TypedVarPtr> >  FuncParamList;
+    return FrameVarsList( frame, FrameVars::Params );
+}
 
-    FuncParamList  paramLst;
-    unsigned long  paramCount;
+///////////////////////////////////////////////////////////////////////////////
 
-    do {
-        AutoRestorePyState  pystate;
-        paramCount = frame->getTypedParamCount();
-        for ( unsigned long i = 0; i < paramCount; ++i )
-        {
-            kdlib::TypedVarPtr  param = frame->getTypedParam(i);
-            std::wstring  paramName =   frame->getTypedParamName(i);
+FrameVarsDict StackFrameAdapter::getParamsDict( kdlib::StackFramePtr&  frame)
+{
+    return FrameVarsDict( frame, FrameVars::Params );
+}
 
-            paramLst.push_back( std::make_pair( paramName, param) );
-        }
-    } while(false);
+///////////////////////////////////////////////////////////////////////////////
 
-    python::list  pyLst;
+FrameVarsList StackFrameAdapter::getLocalsList(kdlib::StackFramePtr& frame)
+{
+    return FrameVarsList( frame, FrameVars::Locals );
+}
 
-    for ( unsigned long i = 0; i < paramCount; ++i )
-        pyLst.append( python::make_tuple( paramLst[i].first, paramLst[i].second ) );
+///////////////////////////////////////////////////////////////////////////////
 
-    return pyLst;
+FrameVarsDict StackFrameAdapter::getLocalsDict(kdlib::StackFramePtr& frame)
+{
+    return FrameVarsDict( frame, FrameVars::Locals );
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-python::dict StackFrameAdapter::getParamsDict( kdlib::StackFramePtr&  frame)
+FrameVars::FrameVars( const kdlib::StackFramePtr& frame, VarKind kind ) :
+    m_frame(frame),
+    m_kind(kind),
+    m_namesLoaded(false),
+    m_localCount(0)
+{}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void FrameVars::loadNames()
 {
-    typedef std::vector< std::pair< std::wstring, kdlib::TypedVarPtr> >  FuncParamList;
+    if ( m_namesLoaded )
+        return;
 
-    FuncParamList  paramLst;
-    unsigned long  paramCount;
+    AutoRestorePyState  pystate;
 
-    do {
-        AutoRestorePyState  pystate;
-        paramCount = frame->getTypedParamCount();
+    if ( m_kind == Params )
+    {
+        unsigned long  paramCount = m_frame->getTypedParamCount();
         for ( unsigned long i = 0; i < paramCount; ++i )
-        {
-            kdlib::TypedVarPtr  param = frame->getTypedParam(i);
-            std::wstring  paramName =   frame->getTypedParamName(i);
+            m_names.push_back( m_frame->getTypedParamName(i) );
+    }
+    else
+    {
+        m_localCount = m_frame->getLocalVarCount();
+        for ( unsigned long i = 0; i < m_localCount; ++i )
+            m_names.push_back( m_frame->getLocalVarName(i) );
 
-            paramLst.push_back( std::make_pair( paramName, param) );
-        }
-    } while(false);
+        unsigned long  staticCount = m_frame->getStaticVarCount();
+        for ( unsigned long i = 0; i < staticCount; ++i )
+            m_names.push_back( m_frame->getStaticVarName(i) );
+    }
 
-    python::dict  pyLst;
+    m_vars.resize( m_names.size() );
+    m_namesLoaded = true;
+}
 
-    for ( unsigned long i = 0; i < paramCount; ++i )
-        pyLst[paramLst[i].first] = paramLst[i].second;
+///////////////////////////////////////////////////////////////////////////////
 
-    return pyLst;
+size_t FrameVars::getCount()
+{
+    loadNames();
+    return m_names.size();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-python::list StackFrameAdapter::getLocalsList(kdlib::StackFramePtr& frame)
+size_t FrameVars::checkIndex( long index )
 {
-    typedef std::vector< std::pair< std::wstring, kdlib::TypedVarPtr> >  LocalVarList;
+    loadNames();
 
-    LocalVarList  localLst;
-    unsigned long  localCount;
-    unsigned long  staticCount;
+    long  count = static_cast<long>( m_names.size() );
 
-    do {
-        AutoRestorePyState  pystate;
-        localCount = frame->getLocalVarCount();
-        for ( unsigned long i = 0; i < localCount; ++i )
-        {
-            kdlib::TypedVarPtr  param = frame->getLocalVar(i);
-            std::wstring  paramName =  frame->getLocalVarName(i);
+    if ( index < 0 )
+        index += count;
 
-            localLst.push_back( std::make_pair( paramName, param) );
-        }
+    if ( index < 0 || index >= count )
+        throw kdlib::IndexException(index);
 
-        staticCount = frame->getStaticVarCount();
-        for (unsigned long i = 0; i < staticCount; ++i)
-        {
-            kdlib::TypedVarPtr  param = frame->getStaticVar(i);
-            std::wstring  paramName = frame->getStaticVarName(i);
+    return static_cast<size_t>(index);
+}
+
+///////////////////////////////////////////////////////////////////////////////
 
-            localLst.push_back(std::make_pair(paramName, param));
+bool FrameVars::findName( const std::wstring& name, size_t& index )
+{
+    loadNames();
+
+    // statics are placed after the locals and shadow them, as getLocal does
+    for ( size_t i = m_names.size(); i > 0; --i )
+    {
+        if ( m_names[i - 1] == name )
+        {
+            index = i - 1;
+            return true;
         }
+    }
 
-    } while(false);
+    return false;
+}
 
-    python::list  pyLst;
+///////////////////////////////////////////////////////////////////////////////
 
-    for ( unsigned long i = 0; i < localCount; ++i )
-        pyLst.append( python::make_tuple( localLst[i].first, localLst[i].second ) );
+kdlib::TypedVarPtr FrameVars::getVar( size_t index )
+{
+    if ( !m_vars[index] )
+    {
+        AutoRestorePyState  pystate;
 
-    return pyLst;
+        if ( m_kind == Params )
+            m_vars[index] = m_frame->getTypedParam( static_cast<unsigned long>(index) );
+        else if ( index < m_localCount )
+            m_vars[index] = m_frame->getLocalVar( static_cast<unsigned long>(index) );
+        else
+            m_vars[index] = m_frame->getStaticVar( static_cast<unsigned long>(index - m_localCount) );
+    }
+
+    return m_vars[index];
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-python::dict StackFrameAdapter::getLocalsDict(kdlib::StackFramePtr& frame)
+python::list FrameVars::getNames()
 {
-    typedef std::vector< std::pair< std::wstring, kdlib::TypedVarPtr> >  LocalVarList;
+    loadNames();
 
-    LocalVarList  localLst;
-    unsigned long  localCount;
-    unsigned long  staticCount;
+    python::list  lst;
+    for ( size_t i = 0; i < m_names.size(); ++i )
+        lst.append( m_names[i] );
+    return lst;
+}
 
-    do {
-        AutoRestorePyState  pystate;
-        localCount = frame->getLocalVarCount();
-        for ( unsigned long i = 0; i < localCount; ++i )
-        {
-            kdlib::TypedVarPtr  param = frame->getLocalVar(i);
-            std::wstring  paramName =  frame->getLocalVarName(i);
+///////////////////////////////////////////////////////////////////////////////
 
-            localLst.push_back( std::make_pair( paramName, param) );
-        }
+python::list FrameVars::getValues()
+{
+    loadNames();
 
-        staticCount = frame->getStaticVarCount();
-        for (unsigned long i = 0; i < staticCount; ++i)
-        {
-            kdlib::TypedVarPtr  param = frame->getStaticVar(i);
-            std::wstring  paramName = frame->getStaticVarName(i);
+    python::list  lst;
+    for ( size_t i = 0; i < m_names.size(); ++i )
+        lst.append( getVar(i) );
+    return lst;
+}
 
-            localLst.push_back(std::make_pair(paramName, param));
-        }
+///////////////////////////////////////////////////////////////////////////////
 
-    } while(false);
+python::list FrameVars::getItems()
+{
+    loadNames();
 
-    python::dict  pyLst;
+    python::list  lst;
+    for ( size_t i = 0; i < m_names.size(); ++i )
+        lst.append( python::make_tuple( m_names[i], getVar(i) ) );
+    return lst;
+}
 
-    for ( unsigned long i = 0; i < localCount; ++i )
-        pyLst[localLst[i].first] = localLst[i].second;
+///////////////////////////////////////////////////////////////////////////////
 
-    return pyLst;
+python::tuple FrameVarsList::getItem( long index )
+{
+    size_t  i = checkIndex(index);
+    return python::make_tuple( m_names[i], getVar(i) );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::list FrameVarsList::getSlice( const python::slice& slice )
+{
+    loadNames();
+
+    python::tuple  indices = python::extract<python::tuple>( slice.attr("indices")( m_names.size() ) );
+
+    long  start = python::extract<long>( indices[0] );
+    long  stop = python::extract<long>( indices[1] );
+    long  step = python::extract<long>( indices[2] );
+
+    python::list  lst;
+    for ( long i = start; step > 0 ? i < stop : i > stop; i += step )
+        lst.append( python::make_tuple( m_names[i], getVar(i) ) );
+    return lst;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::object FrameVarsList::equal( const python::object& other )
+{
+    python::extract<FrameVarsList&>  otherVars( other );
+    if ( otherVars.check() )
+        return getItems() == otherVars().getItems();
+
+    return getItems() == other;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+kdlib::TypedVarPtr FrameVarsDict::getItem( const std::wstring& name )
+{
+    size_t  index;
+    if ( findName( name, index ) )
+        return getVar(index);
+
+    std::wstringstream  sstr;
+    sstr << L"frame has no " << ( m_kind == Params ? L"param" : L"local" ) << L" \'" << name << L"\'";
+    throw KeyException(std::string(_bstr_t(sstr.str().c_str())).c_str());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::object FrameVarsDict::get( const std::wstring& name, const python::object& defaultValue )
+{
+    size_t  index;
+    if ( findName( name, index ) )
+        return python::object( getVar(index) );
+
+    return defaultValue;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool FrameVarsDict::contains( const std::wstring& name )
+{
+    size_t  index;
+    return findName( name, index );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::object FrameVarsDict::equal( const python::object& other )
+{
+    python::extract<FrameVarsDict&>  otherVars( other );
+    if ( otherVars.check() )
+        return getDict() == otherVars().getDict();
+
+    return getDict() == other;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -297,4 +531,229 @@ python::tuple CPUContextAdapter::getRegisterByIndex(unsigned long index)
 
 ///////////////////////////////////////////////////////////////////////////////
 
+namespace {
+
+boost::mutex  g_registerSetsLock;
+std::map< kdlib::CPUType, boost::shared_ptr< const RegisterSet > >  g_registerSets;
+
+// kdlib does not expose the register flags, they are read from the engine
+// (the kdlib register indices are the engine ones)
+std::vector<bool> getSubRegisters( unsigned long registerNumber )
+{
+    std::vector<bool>  subRegisters( registerNumber, false );
+
+    IDebugClient5*  client = 0;
+    if ( FAILED( DebugCreate( __uuidof(IDebugClient5), reinterpret_cast<void**>( &client ) ) ) )
+        return subRegisters;
+
+    IDebugRegisters2*  registers = 0;
+    if ( SUCCEEDED( client->QueryInterface( __uuidof(IDebugRegisters2), reinterpret_cast<void**>( &registers ) ) ) )
+    {
+        for ( unsigned long i = 0; i < registerNumber; ++i )
+        {
+            DEBUG_REGISTER_DESCRIPTION  desc = {};
+            if ( SUCCEEDED( registers->GetDescriptionWide( i, NULL, 0, NULL, &desc ) ) )
+                subRegisters[i] = ( desc.Flags & DEBUG_REGISTER_SUB_REGISTER ) != 0;
+        }
+
+        registers->Release();
+    }
+
+    client->Release();
+
+    return subRegisters;
+}
+
+// must be called without the GIL
+boost::shared_ptr< const RegisterSet > getRegisterSet()
+{
+    kdlib::CPUType  cpuMode = kdlib::getCPUMode();
+    unsigned long  registerNumber = kdlib::getRegisterNumber();
+
+    boost::mutex::scoped_lock  lock(g_registerSetsLock);
+
+    boost::shared_ptr< const RegisterSet >&  registers = g_registerSets[cpuMode];
+    if ( !registers || registers->names.size() != registerNumber )
+    {
+        boost::shared_ptr< RegisterSet >  newRegisters( new RegisterSet() );
+        for ( unsigned long i = 0; i < registerNumber; ++i )
+        {
+            newRegisters->names.push_back( kdlib::getRegisterName(i) );
+            newRegisters->indices.insert( std::make_pair( newRegisters->names.back(), i ) );
+        }
+        newRegisters->subRegisters = getSubRegisters( registerNumber );
+        registers = newRegisters;
+    }
+
+    return registers;
+}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+CPUContextSnapshotPtr getContextSnapshot()
+{
+    AutoRestorePyState  pystate;
+    return CPUContextSnapshotPtr( new CPUContextSnapshot() );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void setContext( const CPUContextSnapshot& snapshot )
+{
+    AutoRestorePyState  pystate;
+    snapshot.apply();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void setContextFromDict( const python::dict& registers )
+{
+    std::vector< std::pair<std::wstring, kdlib::NumVariant> >  values;
+
+    python::list  items = registers.items();
+    for ( long i = 0; i < python::len(items); ++i )
+    {
+        python::object  item = items[i];
+        values.push_back( std::make_pair(
+            python::extract<std::wstring>(item[0])(),
+            NumVariantAdaptor::convertToVariant(item[1]) ) );
+    }
+
+    AutoRestorePyState  pystate;
+
+    for ( size_t i = 0; i < values.size(); ++i )
+        kdlib::setRegisterByName( values[i].first, values[i].second );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+CPUContextSnapshot::CPUContextSnapshot()
+{
+    m_threadId = kdlib::getCurrentThreadId();
+    m_cpuMode = kdlib::getCPUMode();
+    m_registers = getRegisterSet();
+
+    m_values.reserve( m_registers->names.size() );
+    m_indices.reserve( m_registers->names.size() );
+
+    for ( unsigned long i = 0; i < m_registers->names.size(); ++i )
+    {
+        try {
+            m_values.push_back( kdlib::getRegisterByIndex(i) );
+            m_indices.push_back(i);
+        }
+        catch( kdlib::DbgException& )
+        {
+            // unsupported register type
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void CPUContextSnapshot::apply() const
+{
+    if ( kdlib::getCurrentThreadId() != m_threadId )
+        throw kdlib::DbgException("the snapshot was taken from another thread");
+
+    if ( kdlib::getCPUMode() != m_cpuMode || kdlib::getRegisterNumber() != m_registers->names.size() )
+        throw kdlib::DbgException("register set of the snapshot does not match the current CPU mode");
+
+    // a sub-register would overwrite its part of the full register value
+    for ( size_t i = 0; i < m_values.size(); ++i )
+    {
+        if ( !m_registers->subRegisters[ m_indices[i] ] )
+            kdlib::setRegisterByIndex( m_indices[i], m_values[i] );
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool CPUContextSnapshot::findName( const std::wstring& name, size_t& index )
+{
+    std::map<std::wstring, unsigned long>::const_iterator  it = m_registers->indices.find(name);
+    if ( it == m_registers->indices.end() )
+        return false;
+
+    std::vector<unsigned long>::const_iterator  slot = std::lower_bound( m_indices.begin(), m_indices.end(), it->second );
+    if ( slot == m_indices.end() || *slot != it->second )
+        return false;
+
+    index = slot - m_indices.begin();
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::object CPUContextSnapshot::getValueByName( const std::wstring& name )
+{
+    size_t  index;
+    if ( findName( name, index ) )
+        return NumVariantAdaptor::convertToPython( m_values[index] );
+
+    std::wstringstream  sstr;
+    sstr << L"context has no register \'" << name << L"\'";
+    throw KeyException(std::string(_bstr_t(sstr.str().c_str())).c_str());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::object CPUContextSnapshot::getAttr( const std::wstring& name )
+{
+    size_t  index;
+    if ( findName( name, index ) )
+        return NumVariantAdaptor::convertToPython( m_values[index] );
+
+    std::wstringstream  sstr;
+    sstr << L"context has no register \'" << name << L"\'";
+    throw AttributeException(std::string(_bstr_t(sstr.str().c_str())).c_str());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::object CPUContextSnapshot::getItemByIndex( long index )
+{
+    long  count = static_cast<long>( m_values.size() );
+
+    if ( index < 0 )
+        index += count;
+
+    if ( index < 0 || index >= count )
+        throw kdlib::IndexException(index);
+
+    return NumVariantAdaptor::convertToPython( m_values[index] );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool CPUContextSnapshot::contains( const std::wstring& name )
+{
+    size_t  index;
+    return findName( name, index );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::list CPUContextSnapshot::getNames()
+{
+    python::list  lst;
+    for ( size_t i = 0; i < m_indices.size(); ++i )
+        lst.append( m_registers->names[ m_indices[i] ] );
+    return lst;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::list CPUContextSnapshot::getItems()
+{
+    python::list  lst;
+    for ( size_t i = 0; i < m_values.size(); ++i )
+        lst.append( python::make_tuple( m_registers->names[ m_indices[i] ], NumVariantAdaptor::convertToPython( m_values[i] ) ) );
+    return lst;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 } // end namespace pykd
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <map>
+#include <vector>
+
 #include <boost/python/tuple.hpp>
 namespace python = boost::python;
 
@@ -14,6 +17,142 @@ namespace pykd {
 
 ///////////////////////////////////////////////////////////////////////////////
 
+// Params or locals (with statics) of a frame. Names are read on the first
+// access, typed variables only for the entries which are asked for
+
+class FrameVars {
+
+public:
+
+    enum VarKind {
+        Params,
+        Locals
+    };
+
+    FrameVars( const kdlib::StackFramePtr& frame, VarKind kind );
+
+    size_t getCount();
+
+    python::list getNames();
+
+    python::list getValues();
+
+    python::list getItems();
+
+protected:
+
+    void loadNames();
+
+    size_t checkIndex( long index );
+
+    bool findName( const std::wstring& name, size_t& index );
+
+    kdlib::TypedVarPtr getVar( size_t index );
+
+    kdlib::StackFramePtr  m_frame;
+    VarKind  m_kind;
+
+    bool  m_namesLoaded;
+    unsigned long  m_localCount;
+    std::vector<std::wstring>  m_names;
+    std::vector<kdlib::TypedVarPtr>  m_vars;
+};
+
+class FrameVarsList : public FrameVars {
+
+public:
+
+    FrameVarsList( const kdlib::StackFramePtr& frame, VarKind kind ) :
+        FrameVars( frame, kind )
+    {}
+
+    size_t getCount() {
+        return FrameVars::getCount();
+    }
+
+    python::list getNames() {
+        return FrameVars::getNames();
+    }
+
+    python::list getValues() {
+        return FrameVars::getValues();
+    }
+
+    python::list getItems() {
+        return FrameVars::getItems();
+    }
+
+    python::tuple getItem( long index );
+
+    python::list getSlice( const python::slice& slice );
+
+    python::object equal( const python::object& other );
+
+    python::object notEqual( const python::object& other ) {
+        return python::object( !equal(other) );
+    }
+
+    python::object repr() {
+        return python::object( python::handle<>( PyObject_Repr( getItems().ptr() ) ) );
+    }
+
+    // iterates through __getitem__, so the values are loaded one by one
+    static python::object getIter( const python::object& self ) {
+        return python::object( python::handle<>( PySeqIter_New( self.ptr() ) ) );
+    }
+};
+
+class FrameVarsDict : public FrameVars {
+
+public:
+
+    FrameVarsDict( const kdlib::StackFramePtr& frame, VarKind kind ) :
+        FrameVars( frame, kind )
+    {}
+
+    size_t getCount() {
+        return FrameVars::getCount();
+    }
+
+    python::list getNames() {
+        return FrameVars::getNames();
+    }
+
+    python::list getValues() {
+        return FrameVars::getValues();
+    }
+
+    python::list getItems() {
+        return FrameVars::getItems();
+    }
+
+    python::object getIter() {
+        return python::object( python::handle<>( PyObject_GetIter( getNames().ptr() ) ) );
+    }
+
+    python::dict getDict() {
+        return python::dict( getItems() );
+    }
+
+    python::object equal( const python::object& other );
+
+    python::object notEqual( const python::object& other ) {
+        return python::object( !equal(other) );
+    }
+
+    python::object repr() {
+        return python::object( python::handle<>( PyObject_Repr( getDict().ptr() ) ) );
+    }
+
+    kdlib::TypedVarPtr getItem( const std::wstring& name );
+
+    python::object get( const std::wstring& name, const python::object& defaultValue = python::object() );
+
+    bool contains( const std::wstring& name );
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
 class StackFrameAdapter {
 
 public:
@@ -44,9 +183,9 @@ public:
 
     static std::wstring print( kdlib::StackFramePtr& frame );
 
-    static python::list getParamsList( kdlib::StackFramePtr& frame);
+    static FrameVarsList getParamsList( kdlib::StackFramePtr& frame);
 
-    static python::dict getParamsDict( kdlib::StackFramePtr& frame);
+    static FrameVarsDict getParamsDict( kdlib::StackFramePtr& frame);
 
     static kdlib::TypedVarPtr getParam( kdlib::StackFramePtr& frame, const std::wstring &paramName ) 
     {
@@ -54,9 +193,9 @@ public:
         return frame->getTypedParam(paramName);
     }
 
-    static python::list getLocalsList(kdlib::StackFramePtr& frame);
+    static FrameVarsList getLocalsList(kdlib::StackFramePtr& frame);
 
-    static python::dict getLocalsDict(kdlib::StackFramePtr& frame);
+    static FrameVarsDict getLocalsDict(kdlib::StackFramePtr& frame);
 
     static kdlib::TypedVarPtr getLocal( kdlib::StackFramePtr& frame, const std::wstring &paramName ) {
         AutoRestorePyState  pystate;
@@ -169,6 +308,74 @@ inline void switchProcessorMode() {
 
 python::list getStack(bool inlineFrames = false);
 
+///////////////////////////////////////////////////////////////////////////////
+
+// Stack walk result with the frame registers captured in one native array.
+// The frames fetched by the walk are kept, so a frame requested by index is
+// not fetched again
+
+class StackTable {
+
+public:
+
+    explicit StackTable( const kdlib::StackPtr& stack );
+
+    unsigned long getFrameCount() const
+    {
+        return static_cast<unsigned long>( m_regs.size() );
+    }
+
+    kdlib::StackFramePtr getFrame( long index );
+
+    kdlib::MEMOFFSET_64 getIP( long index ) {
+        return m_regs[ checkIndex(index) ].ip;
+    }
+
+    kdlib::MEMOFFSET_64 getRET( long index ) {
+        return m_regs[ checkIndex(index) ].ret;
+    }
+
+    kdlib::MEMOFFSET_64 getSP( long index ) {
+        return m_regs[ checkIndex(index) ].sp;
+    }
+
+    kdlib::MEMOFFSET_64 getFP( long index ) {
+        return m_regs[ checkIndex(index) ].fp;
+    }
+
+    python::list getIPs();
+
+    python::list getRETs();
+
+    python::list getSPs();
+
+    python::list getFPs();
+
+    python::list getTable();
+
+    std::wstring print();
+
+private:
+
+    struct FrameRegs {
+        kdlib::MEMOFFSET_64  ip;
+        kdlib::MEMOFFSET_64  ret;
+        kdlib::MEMOFFSET_64  sp;
+        kdlib::MEMOFFSET_64  fp;
+    };
+
+    size_t checkIndex( long index ) const;
+
+    std::vector<FrameRegs>  m_regs;
+    std::vector<kdlib::StackFramePtr>  m_frames;
+};
+
+typedef boost::shared_ptr<StackTable>  StackTablePtr;
+
+StackTablePtr getStackTable(bool inlineFrames = false);
+
+///////////////////////////////////////////////////////////////////////////////
+
 inline kdlib::StackFramePtr getCurrentFrame() {
     AutoRestorePyState  pystate;
     return kdlib::getCurrentStackFrame();
@@ -194,7 +401,7 @@ inline void resetCurrentFrame() {
     kdlib::resetCurrentStackFrame();
 } 
 
-inline python::list getParams() {
+inline FrameVarsList getParams() {
     return StackFrameAdapter::getParamsList( getCurrentFrame() );
 }
 
@@ -206,7 +413,7 @@ inline kdlib::TypedVarPtr getLocal( const std::wstring &name ) {
     return StackFrameAdapter::getLocal( getCurrentFrame(), name );
 }
 
-inline python::list getLocals() {
+inline FrameVarsList getLocals() {
     return StackFrameAdapter::getLocalsList( getCurrentFrame() );
 }
 
@@ -234,6 +441,69 @@ inline kdlib::NumVariant popStack() {
 }
 
 
+///////////////////////////////////////////////////////////////////////////////
+
+// Register names of a CPU mode with the name index. Sub-registers alias a part
+// of another register (eax, ax, al...)
+
+struct RegisterSet {
+    std::vector<std::wstring>  names;
+    std::map<std::wstring, unsigned long>  indices;
+    std::vector<bool>  subRegisters;
+};
+
+// All registers of the current thread read at once. The register set is
+// shared by the snapshots taken in the same CPU mode. The snapshot is applied
+// only to the thread it was taken from and in the same CPU mode
+
+class CPUContextSnapshot {
+
+public:
+
+    CPUContextSnapshot();
+
+    size_t getCount() const {
+        return m_values.size();
+    }
+
+    python::object getValueByName( const std::wstring& name );
+
+    python::object getAttr( const std::wstring& name );
+
+    python::object getItemByIndex( long index );
+
+    bool contains( const std::wstring& name );
+
+    python::list getNames();
+
+    python::list getItems();
+
+    void apply() const;
+
+private:
+
+    bool findName( const std::wstring& name, size_t& index );
+
+    boost::shared_ptr< const RegisterSet >  m_registers;
+
+    kdlib::THREAD_DEBUG_ID  m_threadId;
+    kdlib::CPUType  m_cpuMode;
+
+    // registers of unsupported types are skipped, the indices are ascending
+    std::vector<unsigned long>  m_indices;
+    std::vector<kdlib::NumVariant>  m_values;
+};
+
+typedef boost::shared_ptr<CPUContextSnapshot>  CPUContextSnapshotPtr;
+
+CPUContextSnapshotPtr getContextSnapshot();
+
+void setContext( const CPUContextSnapshot& snapshot );
+
+void setContextFromDict( const python::dict& registers );
+
+///////////////////////////////////////////////////////////////////////////////
+
 class CPUContextAdapter
 {
 public:
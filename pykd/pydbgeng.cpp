@@ -1,10 +1,24 @@
 #include "stdafx.h"
 
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/once.hpp>
+
 #include "kdlib/dbgengine.h"
+#include "kdlib/eventhandler.h"
+#include "kdlib/module.h"
+#include "kdlib/strconvert.h"
 #include "kdlib/typeinfo.h"
 
 #include "pydbgeng.h"
 #include "stladaptor.h"
+#include "pycancel.h"
 #include "variant.h"
 
 namespace pykd {
@@ -25,6 +39,213 @@ python::object evaluate( const std::wstring  &expression,  bool cplusplus )
 
 ///////////////////////////////////////////////////////////////////////////////
 
+namespace {
+
+// Registers the engine callbacks which invalidate the symbol caches below
+// (once, on the first use of a cache)
+void watchSymbolChanges();
+
+// Line table of one module, filled lazily: every resolved address widens the
+// range of its source line, so the following lookups inside the same line are
+// served by a binary search without going to the symbol engine
+
+struct SourceLineRange {
+    kdlib::MEMOFFSET_64  begin;
+    kdlib::MEMOFFSET_64  end;     // last address known to belong to the line
+    size_t  fileIndex;
+    unsigned long  lineno;
+};
+
+struct ModuleLineTable {
+    kdlib::MEMOFFSET_64  end;
+    std::vector<SourceLineRange>  ranges;   // sorted by begin
+    std::vector<std::wstring>  files;
+    std::map<std::wstring, size_t>  fileIndices;
+    std::set<kdlib::MEMOFFSET_64>  noLineInfo;
+};
+
+class SourceLineCache {
+
+public:
+
+    SourceLineCache() :
+        m_processId(-1),
+        m_invalid(false)
+    {}
+
+    // must be called without the GIL
+    void resolve( kdlib::MEMOFFSET_64 offset, std::wstring& fileName, unsigned long& lineno, long& displacement )
+    {
+        // kdlib takes the zero offset as the current instruction
+        if ( offset == 0 )
+            throw kdlib::DbgException("failed to get source line");
+
+        watchSymbolChanges();
+
+        boost::mutex::scoped_lock  lock(m_mutex);
+
+        applyInvalidation();
+
+        kdlib::PROCESS_DEBUG_ID  processId = kdlib::getCurrentProcessId();
+        if ( processId != m_processId )
+        {
+            m_modules.clear();
+            m_processId = processId;
+        }
+
+        ModuleLineTable*  table = findModule(offset);
+        if ( !table )
+        {
+            kdlib::getSourceLine( fileName, lineno, displacement, offset );
+            return;
+        }
+
+        std::vector<SourceLineRange>::iterator  it = findRange(*table, offset);
+        if ( it != table->ranges.end() && offset <= it->end )
+        {
+            fileName = table->files[it->fileIndex];
+            lineno = it->lineno;
+            displacement = static_cast<long>( offset - it->begin );
+            return;
+        }
+
+        if ( table->noLineInfo.find(offset) != table->noLineInfo.end() )
+            throw kdlib::DbgException("failed to get source line");
+
+        try {
+            kdlib::getSourceLine( fileName, lineno, displacement, offset );
+        }
+        catch(kdlib::DbgException&)
+        {
+            table->noLineInfo.insert(offset);
+            throw;
+        }
+
+        insertRange( *table, offset - displacement, offset, fileName, lineno );
+    }
+
+    void clear()
+    {
+        boost::mutex::scoped_lock  lock(m_mutex);
+        m_modules.clear();
+    }
+
+    // The engine callbacks may come while resolve is querying the symbols, so
+    // they only mark the tables; the next resolve drops them
+
+    void invalidateModule( kdlib::MEMOFFSET_64 moduleBase )
+    {
+        boost::mutex::scoped_lock  lock(m_invalidMutex);
+        m_invalidModules.push_back(moduleBase);
+    }
+
+    void invalidate()
+    {
+        boost::mutex::scoped_lock  lock(m_invalidMutex);
+        m_invalid = true;
+    }
+
+private:
+
+    void applyInvalidation()
+    {
+        std::vector<kdlib::MEMOFFSET_64>  modules;
+        bool  invalid;
+
+        {
+            boost::mutex::scoped_lock  lock(m_invalidMutex);
+            modules.swap(m_invalidModules);
+            invalid = m_invalid;
+            m_invalid = false;
+        }
+
+        if ( invalid )
+        {
+            m_modules.clear();
+            return;
+        }
+
+        for ( size_t i = 0; i < modules.size(); ++i )
+            m_modules.erase( modules[i] );
+    }
+
+    ModuleLineTable* findModule( kdlib::MEMOFFSET_64 offset )
+    {
+        std::map<kdlib::MEMOFFSET_64, ModuleLineTable>::iterator  it = m_modules.upper_bound(offset);
+        if ( it != m_modules.begin() )
+        {
+            --it;
+            if ( offset < it->second.end )
+                return &it->second;
+        }
+
+        kdlib::ModulePtr  module;
+        try {
+            module = kdlib::loadModule(offset);
+        }
+        catch(kdlib::DbgException&)
+        {
+            return 0;
+        }
+
+        ModuleLineTable&  table = m_modules[module->getBase()];
+        table.end = module->getEnd();
+        return &table;
+    }
+
+    static std::vector<SourceLineRange>::iterator findRange( ModuleLineTable& table, kdlib::MEMOFFSET_64 offset )
+    {
+        std::vector<SourceLineRange>::iterator  it = std::upper_bound( table.ranges.begin(), table.ranges.end(), offset,
+            []( kdlib::MEMOFFSET_64 off, const SourceLineRange& range ) { return off < range.begin; } );
+
+        return it == table.ranges.begin() ? table.ranges.end() : --it;
+    }
+
+    static void insertRange( ModuleLineTable& table, kdlib::MEMOFFSET_64 begin, kdlib::MEMOFFSET_64 offset, const std::wstring& fileName, unsigned long lineno )
+    {
+        std::vector<SourceLineRange>::iterator  it = findRange(table, offset);
+        if ( it != table.ranges.end() && it->begin == begin )
+        {
+            it->end = std::max(it->end, offset);
+            return;
+        }
+
+        size_t  fileIndex;
+        std::map<std::wstring, size_t>::iterator  fileIt = table.fileIndices.find(fileName);
+        if ( fileIt != table.fileIndices.end() )
+        {
+            fileIndex = fileIt->second;
+        }
+        else
+        {
+            fileIndex = table.files.size();
+            table.files.push_back(fileName);
+            table.fileIndices.insert( std::make_pair(fileName, fileIndex) );
+        }
+
+        SourceLineRange  range = { begin, offset, fileIndex, lineno };
+
+        std::vector<SourceLineRange>::iterator  pos = std::upper_bound( table.ranges.begin(), table.ranges.end(), begin,
+            []( kdlib::MEMOFFSET_64 off, const SourceLineRange& range ) { return off < range.begin; } );
+
+        table.ranges.insert( pos, range );
+    }
+
+    boost::mutex  m_mutex;
+    kdlib::PROCESS_DEBUG_ID  m_processId;
+    std::map<kdlib::MEMOFFSET_64, ModuleLineTable>  m_modules;
+
+    boost::mutex  m_invalidMutex;
+    std::vector<kdlib::MEMOFFSET_64>  m_invalidModules;
+    bool  m_invalid;
+};
+
+SourceLineCache  g_sourceLineCache;
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 python::tuple getSourceLine( kdlib::MEMOFFSET_64 offset )
 {
     std::wstring  fileName;
@@ -33,7 +254,12 @@ python::tuple getSourceLine( kdlib::MEMOFFSET_64 offset )
 
     do {
         AutoRestorePyState  pystate;
-        kdlib::getSourceLine( fileName, lineno, displacement, offset );
+
+        if ( offset == 0 )
+            kdlib::getSourceLine( fileName, lineno, displacement, offset );
+        else
+            g_sourceLineCache.resolve( offset, fileName, lineno, displacement );
+
     } while(false);
 
     return python::make_tuple( fileName, lineno, displacement );
@@ -41,6 +267,63 @@ python::tuple getSourceLine( kdlib::MEMOFFSET_64 offset )
 
 ///////////////////////////////////////////////////////////////////////////////
 
+python::list getSourceLines( const python::list& offsets )
+{
+    std::vector<kdlib::MEMOFFSET_64>  offsetList = listToVector<kdlib::MEMOFFSET_64>(offsets);
+
+    struct LineInfo {
+        bool  resolved;
+        std::wstring  fileName;
+        unsigned long  lineno;
+    };
+
+    std::vector<LineInfo>  lines( offsetList.size() );
+
+    do {
+        AutoRestorePyState  pystate;
+
+        for ( size_t i = 0; i < offsetList.size(); ++i )
+        {
+            lines[i].resolved = false;
+
+            if ( offsetList[i] == 0 )
+                continue;
+
+            long  displacement;
+            try {
+                g_sourceLineCache.resolve( offsetList[i], lines[i].fileName, lines[i].lineno, displacement );
+                lines[i].resolved = true;
+            }
+            catch(kdlib::DbgException&)
+            {
+                lines[i].resolved = false;
+            }
+        }
+
+    } while(false);
+
+    python::list  lst;
+    for ( size_t i = 0; i < lines.size(); ++i )
+    {
+        if ( lines[i].resolved )
+            lst.append( python::make_tuple( lines[i].fileName, lines[i].lineno ) );
+        else
+            lst.append( python::object() );
+    }
+
+    return lst;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void clearSourceLineCache()
+{
+    AutoRestorePyState  pystate;
+    g_sourceLineCache.clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 kdlib::SystemInfo getSystemVersion()
 {
     AutoRestorePyState  pystate;
@@ -198,10 +481,344 @@ python::tuple getBugCheckData()
 
 ///////////////////////////////////////////////////////////////////////////////
 
+namespace {
+
+// Address index of the synthetic symbols added through pykd. findSymbol looks
+// here first, so the symbols imported in bulk are resolved by a map lookup
+// instead of a symbol engine query. The index is kept per process; symbols
+// of a module are dropped when the module is unloaded or reloaded and all of
+// them when the symbol paths change (the engine drops them as well)
+
+struct SyntheticSymbolEntry {
+    kdlib::MEMOFFSET_64  end;
+    std::wstring  name;
+    std::wstring  moduleName;
+    kdlib::SyntheticSymbol  symbol;
+};
+
+class SyntheticSymbolIndex {
+
+public:
+
+    void insert( kdlib::MEMOFFSET_64 offset, unsigned long size, const std::wstring& name, const kdlib::SyntheticSymbol& symbol )
+    {
+        kdlib::PROCESS_DEBUG_ID  processId = kdlib::getCurrentProcessId();
+
+        std::wstring  moduleName = getModuleName( processId, symbol.moduleBase );
+
+        SyntheticSymbolEntry  entry = { offset + ( size ? size : 1 ), name, moduleName, symbol };
+
+        watchSymbolChanges();
+
+        boost::mutex::scoped_lock  lock(m_mutex);
+
+        ProcessSymbols&  process = m_processes[processId];
+
+        SymbolMap::iterator  it = process.symbols.find(offset);
+        if ( it != process.symbols.end() )
+            process.byId.erase( getKey(it->second.symbol) );
+
+        process.symbols[offset] = entry;
+        process.byId[ getKey(symbol) ] = offset;
+    }
+
+    void remove( const kdlib::SyntheticSymbol& symbol )
+    {
+        kdlib::PROCESS_DEBUG_ID  processId = kdlib::getCurrentProcessId();
+
+        boost::mutex::scoped_lock  lock(m_mutex);
+
+        ProcessMap::iterator  process = m_processes.find(processId);
+        if ( process == m_processes.end() )
+            return;
+
+        IdMap::iterator  it = process->second.byId.find( getKey(symbol) );
+        if ( it == process->second.byId.end() )
+            return;
+
+        process->second.symbols.erase( it->second );
+        process->second.byId.erase( it );
+    }
+
+    void removeModule( kdlib::MEMOFFSET_64 moduleBase )
+    {
+        kdlib::PROCESS_DEBUG_ID  processId = kdlib::getCurrentProcessId();
+
+        boost::mutex::scoped_lock  lock(m_mutex);
+
+        ProcessMap::iterator  process = m_processes.find(processId);
+        if ( process == m_processes.end() )
+            return;
+
+        SymbolMap&  symbols = process->second.symbols;
+
+        for ( SymbolMap::iterator it = symbols.begin(); it != symbols.end(); )
+        {
+            if ( it->second.symbol.moduleBase == moduleBase )
+            {
+                process->second.byId.erase( getKey(it->second.symbol) );
+                it = symbols.erase(it);
+            }
+            else
+                ++it;
+        }
+
+        process->second.moduleNames.erase(moduleBase);
+    }
+
+    void clear()
+    {
+        boost::mutex::scoped_lock  lock(m_mutex);
+        m_processes.clear();
+    }
+
+    bool find( kdlib::MEMOFFSET_64 offset, std::wstring& moduleName, std::wstring& name, kdlib::MEMDISPLACEMENT& displacement )
+    {
+        boost::mutex::scoped_lock  lock(m_mutex);
+
+        if ( m_processes.empty() )
+            return false;
+
+        ProcessMap::iterator  process = m_processes.find( kdlib::getCurrentProcessId() );
+        if ( process == m_processes.end() )
+            return false;
+
+        SymbolMap&  symbols = process->second.symbols;
+
+        SymbolMap::iterator  it = symbols.upper_bound(offset);
+        if ( it == symbols.begin() )
+            return false;
+
+        --it;
+        if ( offset >= it->second.end )
+            return false;
+
+        moduleName = it->second.moduleName;
+        name = it->second.name;
+        displacement = static_cast<kdlib::MEMDISPLACEMENT>( offset - it->first );
+        return true;
+    }
+
+private:
+
+    typedef std::pair<kdlib::MEMOFFSET_64, unsigned long long>  SymbolKey;
+    typedef std::map<kdlib::MEMOFFSET_64, SyntheticSymbolEntry>  SymbolMap;
+    typedef std::map<SymbolKey, kdlib::MEMOFFSET_64>  IdMap;
+
+    struct ProcessSymbols {
+        SymbolMap  symbols;
+        IdMap  byId;
+        std::map<kdlib::MEMOFFSET_64, std::wstring>  moduleNames;
+    };
+
+    typedef std::map<kdlib::PROCESS_DEBUG_ID, ProcessSymbols>  ProcessMap;
+
+    static SymbolKey getKey( const kdlib::SyntheticSymbol& symbol )
+    {
+        return SymbolKey( symbol.moduleBase, symbol.symbolId );
+    }
+
+    std::wstring getModuleName( kdlib::PROCESS_DEBUG_ID processId, kdlib::MEMOFFSET_64 moduleBase )
+    {
+        {
+            boost::mutex::scoped_lock  lock(m_mutex);
+
+            ProcessMap::iterator  process = m_processes.find(processId);
+            if ( process != m_processes.end() )
+            {
+                std::map<kdlib::MEMOFFSET_64, std::wstring>::iterator  it = process->second.moduleNames.find(moduleBase);
+                if ( it != process->second.moduleNames.end() )
+                    return it->second;
+            }
+        }
+
+        std::wstring  moduleName;
+        try {
+            moduleName = kdlib::getModuleName(moduleBase);
+        }
+        catch(kdlib::DbgException&)
+        {}
+
+        boost::mutex::scoped_lock  lock(m_mutex);
+        m_processes[processId].moduleNames[moduleBase] = moduleName;
+        return moduleName;
+    }
+
+    boost::mutex  m_mutex;
+    ProcessMap  m_processes;
+};
+
+SyntheticSymbolIndex  g_syntheticSymbols;
+
+// Drops the cached symbol data of a module when the module is unloaded or
+// loaded again and all of it when the symbol paths change
+
+class SymbolCacheWatch : public kdlib::EventHandler
+{
+public:
+
+    kdlib::DebugCallbackResult onModuleLoad( kdlib::MEMOFFSET_64 offset, const std::wstring& ) override
+    {
+        invalidateModule(offset);
+        return kdlib::DebugCallbackNoChange;
+    }
+
+    kdlib::DebugCallbackResult onModuleUnload( kdlib::MEMOFFSET_64 offset, const std::wstring& ) override
+    {
+        invalidateModule(offset);
+        return kdlib::DebugCallbackNoChange;
+    }
+
+    void onChangeSymbolPaths() override
+    {
+        g_sourceLineCache.invalidate();
+        g_syntheticSymbols.clear();
+    }
+
+private:
+
+    static void invalidateModule( kdlib::MEMOFFSET_64 moduleBase )
+    {
+        g_sourceLineCache.invalidateModule(moduleBase);
+        g_syntheticSymbols.removeModule(moduleBase);
+    }
+};
+
+boost::once_flag  g_symbolCacheWatchOnce = BOOST_ONCE_INIT;
+
+void createSymbolCacheWatch()
+{
+    // never destroyed: the engine may call it at any moment
+    new SymbolCacheWatch();
+}
+
+void watchSymbolChanges()
+{
+    boost::call_once( g_symbolCacheWatchOnce, &createSymbolCacheWatch );
+}
+
+struct SyntheticSymbolDesc {
+    kdlib::MEMOFFSET_64  offset;
+    unsigned long  size;
+    std::wstring  name;
+};
+
+// must be called without the GIL; on cancellation the symbols registered so far stay
+size_t registerSyntheticSymbols( const std::vector<SyntheticSymbolDesc>& symbols )
+{
+    size_t  count = 0;
+
+    for ( size_t i = 0; i < symbols.size(); ++i )
+    {
+        checkCancel();
+
+        try {
+            kdlib::SyntheticSymbol  symbol = kdlib::addSyntheticSymbol( symbols[i].offset, symbols[i].size, symbols[i].name );
+            g_syntheticSymbols.insert( symbols[i].offset, symbols[i].size, symbols[i].name, symbol );
+            ++count;
+        }
+        catch(kdlib::DbgException&)
+        {
+            // duplicates and addresses out of any module are skipped
+        }
+    }
+
+    return count;
+}
+
+bool parseHex( const std::string& str, kdlib::MEMOFFSET_64& value )
+{
+    if ( str.empty() )
+        return false;
+
+    char*  end = 0;
+    value = _strtoui64( str.c_str(), &end, 16 );
+    return *end == 0;
+}
+
+// perf map: "<start> <size> <name>", hex numbers, the name may contain spaces
+// MSVC map: " 0001:00000000  name  00401000 f  lib:object" after the
+// "Preferred load address is" header; sizes are taken from the next symbol
+std::vector<SyntheticSymbolDesc> parseSymbolMap( std::istream& stream, kdlib::MEMOFFSET_64 base )
+{
+    std::vector<SyntheticSymbolDesc>  symbols;
+
+    bool  msvcMap = false;
+    kdlib::MEMOFFSET_64  preferredBase = 0;
+
+    std::string  line;
+    while ( std::getline( stream, line ) )
+    {
+        checkCancel();
+
+        if ( !line.empty() && line[line.size() - 1] == '\r' )
+            line.resize( line.size() - 1 );
+
+        static const std::string  preferredLoad = "Preferred load address is";
+        size_t  pos = line.find(preferredLoad);
+        if ( pos != std::string::npos )
+        {
+            std::istringstream  sstr( line.substr( pos + preferredLoad.size() ) );
+            std::string  addr;
+            sstr >> addr;
+            parseHex( addr, preferredBase );
+            msvcMap = true;
+            continue;
+        }
+
+        std::istringstream  sstr(line);
+
+        if ( msvcMap )
+        {
+            std::string  sectionOffset, name, rvaBase;
+            sstr >> sectionOffset >> name >> rvaBase;
+
+            kdlib::MEMOFFSET_64  address;
+            if ( sectionOffset.size() != 13 || sectionOffset[4] != ':' || !parseHex( rvaBase, address ) || address < preferredBase )
+                continue;
+
+            SyntheticSymbolDesc  desc = { ( base ? base : preferredBase ) + address - preferredBase, 0, kdlib::strToWStr(name) };
+            symbols.push_back(desc);
+            continue;
+        }
+
+        std::string  start, size, name;
+        sstr >> start >> size;
+        std::getline( sstr >> std::ws, name );
+
+        kdlib::MEMOFFSET_64  startValue, sizeValue;
+        if ( name.empty() || !parseHex( start, startValue ) || !parseHex( size, sizeValue ) )
+            continue;
+
+        SyntheticSymbolDesc  desc = { base + startValue, static_cast<unsigned long>(sizeValue), kdlib::strToWStr(name) };
+        symbols.push_back(desc);
+    }
+
+    if ( msvcMap )
+    {
+        std::sort( symbols.begin(), symbols.end(),
+            []( const SyntheticSymbolDesc& s1, const SyntheticSymbolDesc& s2 ) { return s1.offset < s2.offset; } );
+
+        for ( size_t i = 0; i < symbols.size(); ++i )
+        {
+            kdlib::MEMOFFSET_64  next = i + 1 < symbols.size() ? symbols[i + 1].offset : symbols[i].offset + 1;
+            symbols[i].size = static_cast<unsigned long>( next > symbols[i].offset ? next - symbols[i].offset : 1 );
+        }
+    }
+
+    return symbols;
+}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 kdlib::SyntheticSymbol addSyntheticSymbol( kdlib::MEMOFFSET_64 offset, unsigned long size, const std::wstring &name )
 {
     AutoRestorePyState pystate;
-    return kdlib::addSyntheticSymbol(offset, size, name);
+    kdlib::SyntheticSymbol  symbol = kdlib::addSyntheticSymbol(offset, size, name);
+    g_syntheticSymbols.insert( offset, size, name, symbol );
+    return symbol;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -209,7 +826,72 @@ kdlib::SyntheticSymbol addSyntheticSymbol( kdlib::MEMOFFSET_64 offset, unsigned
 void removeSyntheticSymbol(const kdlib::SyntheticSymbol& syntheticSymbol)
 {
     AutoRestorePyState pystate;
-    return kdlib::removeSyntheticSymbol(syntheticSymbol);
+    kdlib::removeSyntheticSymbol(syntheticSymbol);
+    g_syntheticSymbols.remove(syntheticSymbol);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+size_t addSyntheticSymbols( kdlib::MEMOFFSET_64 base, const python::list& symbols )
+{
+    std::vector<SyntheticSymbolDesc>  descs;
+
+    size_t  count = python::len(symbols);
+    descs.reserve(count);
+
+    for ( size_t i = 0; i < count; ++i )
+    {
+        python::object  item = symbols[i];
+        SyntheticSymbolDesc  desc = {
+            base + python::extract<kdlib::MEMOFFSET_64>(item[0])(),
+            python::extract<unsigned long>(item[1])(),
+            python::extract<std::wstring>(item[2])() };
+        descs.push_back(desc);
+    }
+
+    AutoRestorePyState pystate;
+    return registerSyntheticSymbols(descs);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+size_t loadSyntheticSymbols( const std::wstring& fileName, kdlib::MEMOFFSET_64 base )
+{
+    AutoRestorePyState pystate;
+
+    std::ifstream  stream( fileName.c_str() );
+    if ( !stream )
+        throw kdlib::DbgException("failed to open symbol map file");
+
+    return registerSyntheticSymbols( parseSymbolMap( stream, base ) );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool lookupSyntheticSymbol( kdlib::MEMOFFSET_64 offset, std::wstring& moduleName, std::wstring& symbolName, kdlib::MEMDISPLACEMENT& displacement )
+{
+    return g_syntheticSymbols.find( offset, moduleName, symbolName, displacement );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::object findSyntheticSymbol( kdlib::MEMOFFSET_64 offset )
+{
+    std::wstring  moduleName;
+    std::wstring  symbolName;
+    kdlib::MEMDISPLACEMENT  displacement = 0;
+
+    bool  found;
+
+    do {
+        AutoRestorePyState pystate;
+        found = lookupSyntheticSymbol( offset, moduleName, symbolName, displacement );
+    } while(false);
+
+    if ( !found )
+        return python::object();
+
+    return python::make_tuple( moduleName, symbolName, displacement );
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -237,7 +919,8 @@ void addSyntheticModule(kdlib::MEMOFFSET_64 base, unsigned long size, const std:
 void removeSyntheticModule(kdlib::MEMOFFSET_64 base)
 {
     AutoRestorePyState pystate;
-    return kdlib::removeSyntheticModule(base);
+    kdlib::removeSyntheticModule(base);
+    g_syntheticSymbols.removeModule(base);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -6,6 +6,7 @@ namespace python = boost::python;
 #include "kdlib/dbgengine.h"
 
 #include "pythreadstate.h"
+#include "pydbgio.h"
 
 namespace pykd {
 
@@ -14,56 +15,56 @@ namespace pykd {
 inline
 kdlib::PROCESS_DEBUG_ID startProcess(const std::wstring  &processName, const kdlib::ProcessDebugFlags& flags = kdlib::ProcessDebugDefault)
 {
-    AutoRestorePyState  pystate;
+    FlushedEngineCall  engineCall;
     return kdlib::startProcess(processName, flags);
 }
 
 inline
 kdlib::PROCESS_DEBUG_ID attachProcess(kdlib::PROCESS_ID pid, const kdlib::ProcessDebugFlags& flags = kdlib::ProcessDebugDefault)
 {
-    AutoRestorePyState  pystate;
+    FlushedEngineCall  engineCall;
     return kdlib::attachProcess(pid, flags);
 }
 
 inline
 void detachProcess( kdlib::PROCESS_DEBUG_ID processId = -1 ) 
 {
-    AutoRestorePyState  pystate;
+    FlushedEngineCall  engineCall;
     kdlib::detachProcess(processId);
 }
 
 inline
 void detachAllProcesses()
 {
-    AutoRestorePyState  pystate;
+    FlushedEngineCall  engineCall;
     kdlib::detachAllProcesses();
 }
 
 inline
 void terminateProcess( kdlib::PROCESS_DEBUG_ID processId = -1)
 {
-    AutoRestorePyState  pystate;
+    FlushedEngineCall  engineCall;
     kdlib::terminateProcess(processId);
 }
 
 inline
 void terminateAllProcesses()
 {
-    AutoRestorePyState  pystate;
+    FlushedEngineCall  engineCall;
     kdlib::terminateAllProcesses();
 }
 
 inline
 kdlib::PROCESS_DEBUG_ID loadDump( const std::wstring &fileName )
 {
-    AutoRestorePyState  pystate;
+    FlushedEngineCall  engineCall;
     return kdlib::loadDump(fileName);
 }
 
 inline 
 void closeDump(kdlib::PROCESS_DEBUG_ID processId = -1)
 {
-    AutoRestorePyState  pystate;
+    FlushedEngineCall  engineCall;
     kdlib::closeDump(processId);
 }
 
@@ -77,7 +78,7 @@ void writeDump( const std::wstring &fileName, bool smallDump )
 inline
 void attachKernel( const std::wstring &connectOptions = L"" )
 {
-    AutoRestorePyState  pystate;
+    FlushedEngineCall  engineCall;
     kdlib::attachKernel(connectOptions);
 }
 
@@ -109,7 +110,7 @@ python::object debugCommand( const std::wstring &command,  bool suppressOutput =
     std::wstring  debugResult;
 
     {
-        AutoRestorePyState  pystate;
+        FlushedEngineCall  engineCall;
         debugResult = kdlib::debugCommand(command, suppressOutput, captureFlags);
     }
 
@@ -333,28 +334,28 @@ void targetBreak()
 inline
 kdlib::ExecutionStatus targetGo()
 {
-    AutoRestorePyState  pystate;
+    FlushedEngineCall  engineCall;
     return kdlib::targetGo();
 }
 
 inline
 kdlib::ExecutionStatus targetStep()
 {
-    AutoRestorePyState  pystate;
-    return  kdlib::targetStep();
+    FlushedEngineCall  engineCall;
+    return kdlib::targetStep();
 }
 
 inline
 kdlib::ExecutionStatus targetStepIn()
 {
-    AutoRestorePyState  pystate;
+    FlushedEngineCall  engineCall;
     return kdlib::targetStepIn();
 }
 
 inline
 kdlib::ExecutionStatus targetStepOut()
 {
-    AutoRestorePyState  pystate;
+    FlushedEngineCall  engineCall;
     return kdlib::targetStepOut();
 }
 
@@ -368,14 +369,14 @@ kdlib::ExecutionStatus targetExecutionStatus()
 inline
 kdlib::ExecutionStatus sourceStep()
 {
-    AutoRestorePyState  pystate;
+    FlushedEngineCall  engineCall;
     return kdlib::sourceStepIn();
 }
 
 inline
 kdlib::ExecutionStatus sourceStepOver()
 {
-    AutoRestorePyState  pystate;
+    FlushedEngineCall  engineCall;
     return kdlib::sourceStepOver();
 }
 
@@ -451,7 +452,7 @@ void removeExtension( const std::wstring &extPath )
 inline
 std::wstring callExtension( kdlib::EXTENSION_ID extId, const std::wstring command, const std::wstring  &params )
 {
-    AutoRestorePyState  pystate;
+    FlushedEngineCall  engineCall;
     return kdlib::callExtension(extId, command, params);
 }
 
@@ -461,6 +462,10 @@ python::object evaluate( const std::wstring  &expression, bool cplusplus = false
 
 python::tuple getSourceLine( kdlib::MEMOFFSET_64 offset = 0 );
 
+python::list getSourceLines( const python::list& offsets );
+
+void clearSourceLineCache();
+
 inline std::wstring getSourceFile(kdlib::MEMOFFSET_64 offset = 0)
 {
     AutoRestorePyState  pystate;
@@ -487,6 +492,11 @@ kdlib::SyntheticSymbol addSyntheticSymbol( kdlib::MEMOFFSET_64 offset, unsigned
 void removeSyntheticSymbol(const kdlib::SyntheticSymbol& syntheticSymbol);
 std::wstring printSyntheticSymbol(const kdlib::SyntheticSymbol& syntheticSymbol);
 
+size_t addSyntheticSymbols( kdlib::MEMOFFSET_64 base, const python::list& symbols );
+size_t loadSyntheticSymbols( const std::wstring& fileName, kdlib::MEMOFFSET_64 base = 0 );
+python::object findSyntheticSymbol( kdlib::MEMOFFSET_64 offset );
+bool lookupSyntheticSymbol( kdlib::MEMOFFSET_64 offset, std::wstring& moduleName, std::wstring& symbolName, kdlib::MEMDISPLACEMENT& displacement );
+
 void addSyntheticModule(kdlib::MEMOFFSET_64 base, unsigned long size, const std::wstring &name, const std::wstring &path = std::wstring{});
 void removeSyntheticModule(kdlib::MEMOFFSET_64 base);
 
@@ -0,0 +1,59 @@
+#include "stdafx.h"
+
+#include "pydbgio.h"
+
+namespace pykd {
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+const size_t  outputBufferSize = 0x1000;
+
+std::wstring  g_outputBuffer;
+
+bool  g_lineBuffered = false;
+
+} // anonymous namespace
+
+///////////////////////////////////////////////////////////////////////////////
+
+void flushDbgOut()
+{
+    if ( g_outputBuffer.empty() )
+        return;
+
+    std::wstring  text;
+    text.swap( g_outputBuffer );
+
+    AutoRestorePyState  pystate;
+    kdlib::windbg::WindbgOut().write( text );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void setDbgOutLineBuffered( bool lineBuffered )
+{
+    flushDbgOut();
+    g_lineBuffered = lineBuffered;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void DbgOut::write( const std::wstring& str )
+{
+    if ( g_outputBuffer.capacity() < outputBufferSize )
+        g_outputBuffer.reserve( outputBufferSize );
+
+    g_outputBuffer += str;
+
+    if ( g_outputBuffer.size() >= outputBufferSize ||
+        ( g_lineBuffered && str.find( L'\n' ) != std::wstring::npos ) )
+    {
+        flushDbgOut();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+} // end namespace pykd
@@ -57,21 +57,65 @@ inline void setStatusMessage(const std::wstring &str)
 
 ///////////////////////////////////////////////////////////////////////////////
 
-class DbgOut : public  kdlib::windbg::WindbgOut
+// sys.stdout and sys.stderr share one output buffer: text goes to the engine
+// when the buffer is full, on flush, before engine calls producing output and,
+// in the line buffered mode (the interactive console), after each line.
+// The buffer is guarded by the GIL, so all these functions require it
+
+void flushDbgOut();
+
+void setDbgOutLineBuffered( bool lineBuffered );
+
+// Releases the GIL for an engine call which may print or run the target:
+// the buffered output goes out first, and what Python event handlers print
+// while the call runs is written out after it
+
+class FlushedEngineCall
 {
 public:
 
-    virtual void write( const std::wstring& str ) {
-        AutoRestorePyState  pystate;
-        kdlib::windbg::WindbgOut::write(str);
+    FlushedEngineCall()
+    {
+        flushDbgOut();
+        m_state = PyEval_SaveThread();
+    }
+
+    explicit FlushedEngineCall(PyThreadState **state)
+    {
+        flushDbgOut();
+        *state = PyEval_SaveThread();
+        m_state = *state;
+    }
+
+    ~FlushedEngineCall()
+    {
+        PyEval_RestoreThread( m_state );
+
+        try {
+            flushDbgOut();
+        }
+        catch(...)
+        {}
     }
 
+private:
+
+    PyThreadState*    m_state;
+};
+
+class DbgOut : public  kdlib::windbg::WindbgOut
+{
+public:
+
+    virtual void write( const std::wstring& str );
+
     virtual void writedml( const std::wstring& str ) {
-        AutoRestorePyState  pystate;
+        FlushedEngineCall  engineCall;
         kdlib::windbg::WindbgOut::writedml(str);
     }
 
     void flush() {
+        flushDbgOut();
     }
 
     std::wstring encoding() {
@@ -94,7 +138,7 @@ class DbgIn : public kdlib::windbg::WindbgIn
 public:
 
     std::wstring readline() {
-        AutoRestorePyState  pystate;
+        FlushedEngineCall  engineCall;
         return kdlib::windbg::WindbgIn::readline();
     }
 
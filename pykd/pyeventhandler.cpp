@@ -1,17 +1,294 @@
 #include "stdafx.h"
 
+#include <memory>
+#include <algorithm>
+#include <sstream>
+
 #include "kdlib\eventhandler.h"
+#include "kdlib\memaccess.h"
+#include "kdlib\cpucontext.h"
 
 #include "pyeventhandler.h"
+#include "pytypeinfo.h"
+#include "pydbgio.h"
 #include "dbgexcept.h"
 
 namespace pykd {
 
 ///////////////////////////////////////////////////////////////////////////////
 
-EventHandler::EventHandler()
+namespace {
+
+// Python handlers print into the buffered dbgout: the text is written out
+// before the GIL goes back to the engine, not on the next pykd call
+
+PyThreadState* saveThreadFlushed()
+{
+    flushDbgOut();
+    return PyEval_SaveThread();
+}
+
+// event handlers and breakpoints calling Python by interpreter, guarded by the GIL
+
+std::map<PyInterpreterState*, size_t>  g_pythonCallbacks;
+
+void addPythonCallback( PyThreadState* state )
+{
+    ++g_pythonCallbacks[ state->interp ];
+}
+
+void releasePythonCallback( PyThreadState* state )
+{
+    std::map<PyInterpreterState*, size_t>::iterator  found = g_pythonCallbacks.find( state->interp );
+    if ( found != g_pythonCallbacks.end() && --found->second == 0 )
+        g_pythonCallbacks.erase( found );
+}
+
+} // anonymous namespace
+
+///////////////////////////////////////////////////////////////////////////////
+
+EventHandler::EventHandler() :
+    m_overrides( 0 ),
+    m_overridesResolved( false ),
+    m_queued( false ),
+    m_batchSize( 0 ),
+    m_capacity( 0x10000 ),
+    m_dropped( 0 )
 {
     m_pystate = PyThreadState_Get();
+    addPythonCallback( m_pystate );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+EventHandler::~EventHandler()
+{
+    releasePythonCallback( m_pystate );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool EventHandler::hasOverride( HandlerId handler )
+{
+    // the python object is bound to the wrapper after the constructor, so the
+    // overrides are resolved on the first event, later events skip the GIL
+    if ( !m_overridesResolved )
+    {
+        PyEval_RestoreThread( m_pystate );
+
+        for ( unsigned long handler = OnBreakpointHandler; handler <= OnEventsHandler; handler <<= 1 )
+        {
+            if ( get_override( getHandlerName( HandlerId(handler) ) ) )
+                m_overrides |= handler;
+        }
+
+        m_overridesResolved = true;
+
+        m_pystate = PyEval_SaveThread();
+    }
+
+    return ( m_overrides & handler ) != 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+const char* EventHandler::getHandlerName( HandlerId handler )
+{
+    switch ( handler )
+    {
+    case OnBreakpointHandler: return "onBreakpoint";
+    case OnExceptionHandler: return "onException";
+    case OnLoadModuleHandler: return "onLoadModule";
+    case OnUnloadModuleHandler: return "onUnloadModule";
+    case OnThreadStartHandler: return "onThreadStart";
+    case OnThreadStopHandler: return "onThreadStop";
+    case OnExecutionStatusChangeHandler: return "onExecutionStatusChange";
+    case OnCurrentThreadChangeHandler: return "onCurrentThreadChange";
+    case OnChangeLocalScopeHandler: return "onChangeLocalScope";
+    case OnChangeSymbolPathsHandler: return "onChangeSymbolPaths";
+    case OnChangeBreakpointsHandler: return "onChangeBreakpoints";
+    case OnDebugOutputHandler: return "onDebugOutput";
+    case OnStartInputHandler: return "onStartInput";
+    case OnStopInputHandler: return "onStopInput";
+    case OnEventsHandler: return "onEvents";
+    default: break;
+    }
+
+    return "";
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void EventHandler::setQueuedMode( bool queued, size_t batchSize, size_t capacity )
+{
+    if ( capacity == 0 )
+        throw kdlib::DbgException("Event queue capacity must not be zero");
+
+    if ( !queued )
+        flushEvents();
+
+    AutoRestorePyState  pystate;
+    boost::mutex::scoped_lock  lock(m_queueLock);
+
+    m_queued = queued;
+    m_batchSize = batchSize;
+    m_capacity = capacity;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+unsigned long long EventHandler::getDroppedEvents()
+{
+    AutoRestorePyState  pystate;
+    boost::mutex::scoped_lock  lock(m_queueLock);
+
+    return m_dropped;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool EventHandler::queueEvent( HandlerId handler, kdlib::MEMOFFSET_64 offset, unsigned long long value, const std::wstring& text )
+{
+    if ( !m_queued )
+        return false;
+
+    if ( !hasOverride( handler ) && !hasOverride( OnEventsHandler ) )
+        return true;
+
+    QueuedEvent  event = { handler, offset, value, text };
+
+    bool  batchReady;
+
+    {
+        boost::mutex::scoped_lock  lock(m_queueLock);
+
+        if ( m_queue.size() >= m_capacity )
+        {
+            m_queue.pop_front();
+            ++m_dropped;
+        }
+
+        m_queue.push_back( event );
+        batchReady = m_batchSize != 0 && m_queue.size() >= m_batchSize;
+    }
+
+    if ( batchReady )
+    {
+        PyEval_RestoreThread( m_pystate );
+        deliverEvents();
+        m_pystate = saveThreadFlushed();
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void EventHandler::flushEvents()
+{
+    deliverEvents();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::tuple EventHandler::eventToTuple( const QueuedEvent& event )
+{
+    const char*  name = getHandlerName( event.handler );
+
+    switch ( event.handler )
+    {
+    case OnLoadModuleHandler:
+    case OnUnloadModuleHandler:
+        return python::make_tuple( name, event.offset, event.text );
+
+    case OnExecutionStatusChangeHandler:
+        return python::make_tuple( name, kdlib::ExecutionStatus( event.value ) );
+
+    case OnCurrentThreadChangeHandler:
+        return python::make_tuple( name, kdlib::THREAD_DEBUG_ID( event.value ) );
+
+    case OnDebugOutputHandler:
+        return python::make_tuple( name, event.text, kdlib::OutputFlag( event.value ) );
+
+    default:
+        break;
+    }
+
+    return python::make_tuple( name );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void EventHandler::deliverEvents()
+{
+    std::deque<QueuedEvent>  events;
+
+    {
+        boost::mutex::scoped_lock  lock(m_queueLock);
+        events.swap( m_queue );
+    }
+
+    if ( events.empty() )
+        return;
+
+    python::override  eventsHandler = get_override( "onEvents" );
+    if ( eventsHandler )
+    {
+        try {
+
+            python::list  lst;
+            for ( std::deque<QueuedEvent>::const_iterator it = events.begin(); it != events.end(); ++it )
+                lst.append( eventToTuple( *it ) );
+
+            eventsHandler( lst );
+        }
+        catch (const python::error_already_set &)
+        {
+            printException();
+        }
+
+        return;
+    }
+
+    // a failed handler must not lose the rest of the batch
+    for ( std::deque<QueuedEvent>::const_iterator it = events.begin(); it != events.end(); ++it )
+    {
+        try {
+
+            python::override  pythonHandler = get_override( getHandlerName( it->handler ) );
+            if ( !pythonHandler )
+                continue;
+
+            switch ( it->handler )
+            {
+            case OnLoadModuleHandler:
+            case OnUnloadModuleHandler:
+                pythonHandler( it->offset, it->text );
+                break;
+
+            case OnExecutionStatusChangeHandler:
+                pythonHandler( kdlib::ExecutionStatus( it->value ) );
+                break;
+
+            case OnCurrentThreadChangeHandler:
+                pythonHandler( kdlib::THREAD_DEBUG_ID( it->value ) );
+                break;
+
+            case OnDebugOutputHandler:
+                pythonHandler( it->text, kdlib::OutputFlag( it->value ) );
+                break;
+
+            default:
+                pythonHandler();
+                break;
+            }
+        }
+        catch (const python::error_already_set &)
+        {
+            printException();
+        }
+    }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -20,6 +297,9 @@ kdlib::DebugCallbackResult EventHandler::onBreakpoint( kdlib::BREAKPOINT_ID bpId
 {
     kdlib::DebugCallbackResult  result = kdlib::DebugCallbackNoChange;
 
+    if ( !hasOverride( OnBreakpointHandler ) )
+        return kdlib::EventHandler::onBreakpoint( bpId );
+
     PyEval_RestoreThread( m_pystate );
 
     try {
@@ -66,7 +346,7 @@ kdlib::DebugCallbackResult EventHandler::onBreakpoint( kdlib::BREAKPOINT_ID bpId
         result =  kdlib::DebugCallbackBreak;
     }
 
-    m_pystate = PyEval_SaveThread();
+    m_pystate = saveThreadFlushed();
 
     return result;
 }
@@ -75,6 +355,21 @@ kdlib::DebugCallbackResult EventHandler::onBreakpoint( kdlib::BREAKPOINT_ID bpId
 
 void EventHandler::onExecutionStatusChange( kdlib::ExecutionStatus executionStatus )
 {
+    if ( queueEvent( OnExecutionStatusChangeHandler, 0, executionStatus ) )
+    {
+        // the target is stopped, the queued events do not stall it anymore
+        if ( executionStatus == kdlib::DebugStatusBreak || executionStatus == kdlib::DebugStatusNoDebuggee )
+        {
+            PyEval_RestoreThread( m_pystate );
+            deliverEvents();
+            m_pystate = saveThreadFlushed();
+        }
+        return;
+    }
+
+    if ( !hasOverride( OnExecutionStatusChangeHandler ) )
+        return;
+
     PyEval_RestoreThread( m_pystate );
 
     try {
@@ -90,7 +385,7 @@ void EventHandler::onExecutionStatusChange( kdlib::ExecutionStatus executionStat
         printException();
     }
 
-    m_pystate = PyEval_SaveThread();
+    m_pystate = saveThreadFlushed();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -99,6 +394,9 @@ kdlib::DebugCallbackResult EventHandler::onException( const kdlib::ExceptionInfo
 {
     kdlib::DebugCallbackResult  result = kdlib::DebugCallbackNoChange;
 
+    if ( !hasOverride( OnExceptionHandler ) )
+        return kdlib::EventHandler::onException( exceptionInfo );
+
     PyEval_RestoreThread( m_pystate );
 
     try {
@@ -145,7 +443,7 @@ kdlib::DebugCallbackResult EventHandler::onException( const kdlib::ExceptionInfo
         result =  kdlib::DebugCallbackBreak;
     }
 
-    m_pystate = PyEval_SaveThread();
+    m_pystate = saveThreadFlushed();
 
     return result;
 }
@@ -156,6 +454,12 @@ kdlib::DebugCallbackResult  EventHandler::onModuleLoad( kdlib::MEMOFFSET_64 offs
 {
     kdlib::DebugCallbackResult  result = kdlib::DebugCallbackNoChange;
 
+    if ( queueEvent( OnLoadModuleHandler, offset, 0, name ) )
+        return kdlib::DebugCallbackNoChange;
+
+    if ( !hasOverride( OnLoadModuleHandler ) )
+        return kdlib::EventHandler::onModuleLoad( offset, name );
+
     PyEval_RestoreThread( m_pystate );
 
     try {
@@ -202,7 +506,7 @@ kdlib::DebugCallbackResult  EventHandler::onModuleLoad( kdlib::MEMOFFSET_64 offs
         result =  kdlib::DebugCallbackBreak;
     }
 
-    m_pystate = PyEval_SaveThread();
+    m_pystate = saveThreadFlushed();
 
     return result;
 }
@@ -213,6 +517,12 @@ kdlib::DebugCallbackResult  EventHandler::onModuleUnload( kdlib::MEMOFFSET_64 of
 {
     kdlib::DebugCallbackResult  result = kdlib::DebugCallbackNoChange;
 
+    if ( queueEvent( OnUnloadModuleHandler, offset, 0, name ) )
+        return kdlib::DebugCallbackNoChange;
+
+    if ( !hasOverride( OnUnloadModuleHandler ) )
+        return kdlib::EventHandler::onModuleUnload( offset, name );
+
     PyEval_RestoreThread( m_pystate );
 
     try {
@@ -259,7 +569,7 @@ kdlib::DebugCallbackResult  EventHandler::onModuleUnload( kdlib::MEMOFFSET_64 of
         result =  kdlib::DebugCallbackBreak;
     }
 
-    m_pystate = PyEval_SaveThread();
+    m_pystate = saveThreadFlushed();
 
     return result;
 }
@@ -270,6 +580,12 @@ kdlib::DebugCallbackResult EventHandler::onThreadStart()
 {
     kdlib::DebugCallbackResult  result = kdlib::DebugCallbackNoChange;
 
+    if ( queueEvent( OnThreadStartHandler ) )
+        return kdlib::DebugCallbackNoChange;
+
+    if ( !hasOverride( OnThreadStartHandler ) )
+        return kdlib::EventHandler::onThreadStart();
+
     PyEval_RestoreThread(m_pystate);
 
     try {
@@ -316,7 +632,7 @@ kdlib::DebugCallbackResult EventHandler::onThreadStart()
         result = kdlib::DebugCallbackBreak;
     }
 
-    m_pystate = PyEval_SaveThread();
+    m_pystate = saveThreadFlushed();
 
     return result;
 }
@@ -327,6 +643,12 @@ kdlib::DebugCallbackResult EventHandler::onThreadStop()
 {
     kdlib::DebugCallbackResult  result = kdlib::DebugCallbackNoChange;
 
+    if ( queueEvent( OnThreadStopHandler ) )
+        return kdlib::DebugCallbackNoChange;
+
+    if ( !hasOverride( OnThreadStopHandler ) )
+        return kdlib::EventHandler::onThreadStop();
+
     PyEval_RestoreThread(m_pystate);
 
     try {
@@ -372,7 +694,7 @@ kdlib::DebugCallbackResult EventHandler::onThreadStop()
         result = kdlib::DebugCallbackBreak;
     }
 
-    m_pystate = PyEval_SaveThread();
+    m_pystate = saveThreadFlushed();
 
     return result;
 }
@@ -381,6 +703,12 @@ kdlib::DebugCallbackResult EventHandler::onThreadStop()
 
 void EventHandler::onCurrentThreadChange(kdlib::THREAD_DEBUG_ID  threadid)
 {
+    if ( queueEvent( OnCurrentThreadChangeHandler, 0, threadid ) )
+        return;
+
+    if ( !hasOverride( OnCurrentThreadChangeHandler ) )
+        return;
+
     PyEval_RestoreThread( m_pystate );
 
     try {
@@ -396,13 +724,19 @@ void EventHandler::onCurrentThreadChange(kdlib::THREAD_DEBUG_ID  threadid)
         printException();
     }
 
-    m_pystate = PyEval_SaveThread();
+    m_pystate = saveThreadFlushed();
 }
 
 /////////////////////////////////////////////////////////////////////////////////
 
 void EventHandler::onChangeLocalScope()
 {
+    if ( queueEvent( OnChangeLocalScopeHandler ) )
+        return;
+
+    if ( !hasOverride( OnChangeLocalScopeHandler ) )
+        return;
+
     PyEval_RestoreThread( m_pystate );
 
     try {
@@ -418,7 +752,7 @@ void EventHandler::onChangeLocalScope()
         printException();
     }
 
-    m_pystate = PyEval_SaveThread();
+    m_pystate = saveThreadFlushed();
 }
 
 
@@ -426,6 +760,12 @@ void EventHandler::onChangeLocalScope()
 
 void EventHandler::onChangeSymbolPaths()
 {
+    if ( queueEvent( OnChangeSymbolPathsHandler ) )
+        return;
+
+    if ( !hasOverride( OnChangeSymbolPathsHandler ) )
+        return;
+
     PyEval_RestoreThread( m_pystate );
 
     try {
@@ -441,13 +781,19 @@ void EventHandler::onChangeSymbolPaths()
         printException();
     }
 
-    m_pystate = PyEval_SaveThread();
+    m_pystate = saveThreadFlushed();
 }
 
 /////////////////////////////////////////////////////////////////////////////////
 
 void EventHandler::onChangeBreakpoints()
 {
+    if ( queueEvent( OnChangeBreakpointsHandler ) )
+        return;
+
+    if ( !hasOverride( OnChangeBreakpointsHandler ) )
+        return;
+
     PyEval_RestoreThread(m_pystate);
 
     try {
@@ -463,13 +809,19 @@ void EventHandler::onChangeBreakpoints()
         printException();
     }
 
-    m_pystate = PyEval_SaveThread();
+    m_pystate = saveThreadFlushed();
 }
 
 /////////////////////////////////////////////////////////////////////////////////
 
 void EventHandler::onDebugOutput(const std::wstring& text, kdlib::OutputFlag flag)
 {
+    if ( queueEvent( OnDebugOutputHandler, 0, flag, text ) )
+        return;
+
+    if ( !hasOverride( OnDebugOutputHandler ) )
+        return;
+
     PyEval_RestoreThread( m_pystate );
 
     try {
@@ -485,13 +837,19 @@ void EventHandler::onDebugOutput(const std::wstring& text, kdlib::OutputFlag fla
         printException();
     }
 
-    m_pystate = PyEval_SaveThread();
+    m_pystate = saveThreadFlushed();
 }
 
 /////////////////////////////////////////////////////////////////////////////////
 
 void EventHandler::onStartInput()
 {
+    if ( queueEvent( OnStartInputHandler ) )
+        return;
+
+    if ( !hasOverride( OnStartInputHandler ) )
+        return;
+
     PyEval_RestoreThread(m_pystate);
 
     try {
@@ -507,13 +865,19 @@ void EventHandler::onStartInput()
         printException();
     }
 
-    m_pystate = PyEval_SaveThread();
+    m_pystate = saveThreadFlushed();
 }
 
 /////////////////////////////////////////////////////////////////////////////////
 
 void EventHandler::onStopInput()
 {
+    if ( queueEvent( OnStopInputHandler ) )
+        return;
+
+    if ( !hasOverride( OnStopInputHandler ) )
+        return;
+
     PyEval_RestoreThread(m_pystate);
 
     try {
@@ -529,7 +893,7 @@ void EventHandler::onStopInput()
         printException();
     }
 
-    m_pystate = PyEval_SaveThread();
+    m_pystate = saveThreadFlushed();
 }
 
 /////////////////////////////////////////////////////////////////////////////////
@@ -538,42 +902,72 @@ Breakpoint::Breakpoint(kdlib::BreakpointPtr bp, bool weakbp)
 {
     m_breakpoint = bp;
     m_weakBp = weakbp;
+    m_hitCallback = false;
 }
 
 Breakpoint::Breakpoint(kdlib::MEMOFFSET_64 offset)
 {
-    AutoRestorePyState  pystate(&m_pystate);
-    m_breakpoint = kdlib::softwareBreakPointSet(offset, this);
+    do {
+        AutoRestorePyState  pystate(&m_pystate);
+        m_breakpoint = kdlib::softwareBreakPointSet(offset, this);
+    } while(false);
+
     m_weakBp = false;
+    m_hitCallback = true;
+
+    addPythonCallback( m_pystate );
 }
 
 Breakpoint::Breakpoint(kdlib::MEMOFFSET_64 offset, python::object  &callback)
 {
     m_callback = callback;
-    AutoRestorePyState  pystate(&m_pystate);
-    m_breakpoint = kdlib::softwareBreakPointSet(offset, this);
+
+    do {
+        AutoRestorePyState  pystate(&m_pystate);
+        m_breakpoint = kdlib::softwareBreakPointSet(offset, this);
+    } while(false);
+
     m_weakBp = false;
+    m_hitCallback = true;
+
+    addPythonCallback( m_pystate );
 }
 
 Breakpoint::Breakpoint(kdlib::MEMOFFSET_64 offset, size_t size, kdlib::ACCESS_TYPE accessType)
 {
-    AutoRestorePyState  pystate(&m_pystate);
-    m_breakpoint = kdlib::hardwareBreakPointSet(offset, size, accessType, this);
+    do {
+        AutoRestorePyState  pystate(&m_pystate);
+        m_breakpoint = kdlib::hardwareBreakPointSet(offset, size, accessType, this);
+    } while(false);
+
     m_weakBp = false;
+    m_hitCallback = true;
+
+    addPythonCallback( m_pystate );
 }
 
 Breakpoint::Breakpoint(kdlib::MEMOFFSET_64 offset, size_t size, kdlib::ACCESS_TYPE accessType, python::object  &callback)
 {
     m_callback = callback;
-    AutoRestorePyState  pystate(&m_pystate);
-    m_breakpoint = kdlib::hardwareBreakPointSet(offset, size, accessType, this);
+
+    do {
+        AutoRestorePyState  pystate(&m_pystate);
+        m_breakpoint = kdlib::hardwareBreakPointSet(offset, size, accessType, this);
+    } while(false);
+
     m_weakBp = false;
+    m_hitCallback = true;
+
+    addPythonCallback( m_pystate );
 }
 
 /////////////////////////////////////////////////////////////////////////////////
 
 Breakpoint::~Breakpoint()
 {
+    if ( m_hitCallback )
+        releasePythonCallback( m_pystate );
+
     AutoRestorePyState  pystate;
     if (!m_weakBp && m_breakpoint )
     {
@@ -587,6 +981,21 @@ kdlib::DebugCallbackResult Breakpoint::onHit()
 {
     kdlib::DebugCallbackResult  result = kdlib::DebugCallbackNoChange;
 
+    NativeExpressionPtr  condition = m_condition;
+    if ( condition )
+    {
+        try {
+            if ( condition->evaluate() == 0 )
+                return kdlib::DebugCallbackProceed;
+        }
+        catch (const kdlib::DbgException& err)
+        {
+            // the target breaks, the user must see why
+            kdlib::eprintln( L"breakpoint condition '" + condition->getText() + L"' failed: " + kdlib::strToWStr( err.what() ) );
+            return kdlib::DebugCallbackBreak;
+        }
+    }
+
     PyEval_RestoreThread( m_pystate );
 
     try {
@@ -640,7 +1049,7 @@ kdlib::DebugCallbackResult Breakpoint::onHit()
         result =  kdlib::DebugCallbackBreak;
     }
 
-    m_pystate = PyEval_SaveThread();
+    m_pystate = saveThreadFlushed();
 
     return result;
 }
@@ -678,6 +1087,11 @@ Breakpoint* Breakpoint::detach()
             throw kdlib::DbgException("Cannot detach breakpoint with callback");
         }
 
+        if (m_condition)
+        {
+            throw kdlib::DbgException("Cannot detach breakpoint with condition");
+        }
+
         auto  bp = m_breakpoint;
         m_breakpoint = 0;
         return new Breakpoint(bp);
@@ -688,34 +1102,61 @@ Breakpoint* Breakpoint::detach()
 
 /////////////////////////////////////////////////////////////////////////////////
 
-Breakpoint* Breakpoint::setSoftwareBreakpoint( kdlib::MEMOFFSET_64 offset, python::object  &callback )
+void Breakpoint::setCondition( const std::wstring& condition )
 {
-    if (!callback)
+    AutoRestorePyState  pystate;
+
+    if ( condition.empty() )
     {
-        AutoRestorePyState  pystate;
-        kdlib::BreakpointPtr  bp = kdlib::softwareBreakPointSet(offset, 0);
-        return new Breakpoint(bp, false);
+        m_condition.reset();
+        return;
     }
-    else
+
+    if (!m_hitCallback)
     {
-        return new Breakpoint(offset, callback);
+        throw kdlib::DbgException("Cannot set condition, breakpoint is created without callback");
     }
+
+    m_condition = NativeExpressionPtr( new NativeExpression(condition) );
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+
+std::wstring Breakpoint::getCondition() const
+{
+    return m_condition ? m_condition->getText() : std::wstring();
 }
 
 /////////////////////////////////////////////////////////////////////////////////
 
-Breakpoint* Breakpoint::setHardwareBreakpoint( kdlib::MEMOFFSET_64 offset, size_t size, kdlib::ACCESS_TYPE accessType, python::object  &callback )
+Breakpoint* Breakpoint::setSoftwareBreakpoint( kdlib::MEMOFFSET_64 offset, python::object  &callback, const std::wstring& condition )
 {
-    if (!callback)
+    if (!callback && condition.empty())
     {
         AutoRestorePyState  pystate;
-        kdlib::BreakpointPtr  bp = kdlib::hardwareBreakPointSet(offset, size, accessType, 0);
+        kdlib::BreakpointPtr  bp = kdlib::softwareBreakPointSet(offset, 0);
         return new Breakpoint(bp, false);
     }
-    else
+
+    std::unique_ptr<Breakpoint>  bp( new Breakpoint(offset, callback) );
+    bp->setCondition(condition);
+    return bp.release();
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+
+Breakpoint* Breakpoint::setHardwareBreakpoint( kdlib::MEMOFFSET_64 offset, size_t size, kdlib::ACCESS_TYPE accessType, python::object  &callback, const std::wstring& condition )
+{
+    if (!callback && condition.empty())
     {
-        return new Breakpoint(offset, size, accessType, callback);
+        AutoRestorePyState  pystate;
+        kdlib::BreakpointPtr  bp = kdlib::hardwareBreakPointSet(offset, size, accessType, 0);
+        return new Breakpoint(bp, false);
     }
+
+    std::unique_ptr<Breakpoint>  bp( new Breakpoint(offset, size, accessType, callback) );
+    bp->setCondition(condition);
+    return bp.release();
 }
 
 /////////////////////////////////////////////////////////////////////////////////
@@ -765,5 +1206,768 @@ void Breakpoint::removeAllBreakpoints()
 
 /////////////////////////////////////////////////////////////////////////////////
 
+CountingBreakpoint::CountingBreakpoint( kdlib::MEMOFFSET_64 offset, unsigned long sampleRate, const std::wstring& condition ) :
+    m_sampleRate( sampleRate ),
+    m_hitCount( 0 )
+{
+    AutoRestorePyState  pystate;
+
+    if ( !condition.empty() )
+        m_condition = NativeExpressionPtr( new NativeExpression(condition) );
+
+    m_breakpoint = kdlib::softwareBreakPointSet(offset, this);
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+
+CountingBreakpoint::~CountingBreakpoint()
+{
+    AutoRestorePyState  pystate;
+    if ( m_breakpoint )
+    {
+        m_breakpoint->remove();
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+
+kdlib::DebugCallbackResult CountingBreakpoint::onHit()
+{
+    try {
+
+        if ( m_condition && m_condition->evaluate() == 0 )
+            return kdlib::DebugCallbackProceed;
+
+        kdlib::THREAD_ID  tid = kdlib::getThreadSystemId(-1);
+
+        boost::mutex::scoped_lock  lock(m_lock);
+
+        ++m_hitCount;
+        ++m_threadCounts[tid];
+
+        if ( m_sampleRate != 0 && m_hitCount % m_sampleRate == 0 )
+            ++m_callers[ kdlib::ptrPtr( kdlib::getStackOffset() ) ];
+    }
+    catch (const kdlib::DbgException&)
+    {
+        // the counting breakpoint never stops the target, a failed condition or
+        // an unreadable stack only lose this hit's data
+    }
+
+    return kdlib::DebugCallbackProceed;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+
+kdlib::BREAKPOINT_ID CountingBreakpoint::getId() const
+{
+    AutoRestorePyState  pystate;
+
+    if ( !m_breakpoint )
+        throw kdlib::DbgException("Breakpoint is removed");
+
+    return m_breakpoint->getId();
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+
+kdlib::MEMOFFSET_64 CountingBreakpoint::getOffset() const
+{
+    AutoRestorePyState  pystate;
+
+    if ( !m_breakpoint )
+        throw kdlib::DbgException("Breakpoint is removed");
+
+    return m_breakpoint->getOffset();
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+
+void CountingBreakpoint::remove()
+{
+    AutoRestorePyState  pystate;
+    if (m_breakpoint)
+    {
+        m_breakpoint->remove();
+        m_breakpoint = 0;
+        return;
+    }
+
+    throw kdlib::DbgException("Cannot remove breakpoint, it is already removed");
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+
+unsigned long long CountingBreakpoint::getHitCount()
+{
+    AutoRestorePyState  pystate;
+    boost::mutex::scoped_lock  lock(m_lock);
+    return m_hitCount;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+
+python::dict CountingBreakpoint::getThreadCounts()
+{
+    ThreadCounts  threadCounts;
+
+    do {
+        AutoRestorePyState  pystate;
+        boost::mutex::scoped_lock  lock(m_lock);
+        threadCounts = m_threadCounts;
+    } while(false);
+
+    python::dict  dct;
+    for ( ThreadCounts::const_iterator it = threadCounts.begin(); it != threadCounts.end(); ++it )
+        dct[it->first] = it->second;
+
+    return dct;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct CallerRow {
+    kdlib::MEMOFFSET_64  caller;
+    unsigned long long  count;
+    std::wstring  symbol;
+};
+
+bool moreFrequent( const CallerRow& row1, const CallerRow& row2 )
+{
+    return row1.count > row2.count;
+}
+
+std::vector<CallerRow> getCallerRows( const std::map<kdlib::MEMOFFSET_64, unsigned long long>& callers )
+{
+    std::vector<CallerRow>  rows;
+    rows.reserve( callers.size() );
+
+    for ( std::map<kdlib::MEMOFFSET_64, unsigned long long>::const_iterator it = callers.begin(); it != callers.end(); ++it )
+    {
+        CallerRow  row;
+        row.caller = it->first;
+        row.count = it->second;
+        row.symbol = formatSymbol( it->first, true );
+        rows.push_back(row);
+    }
+
+    std::stable_sort( rows.begin(), rows.end(), moreFrequent );
+
+    return rows;
+}
+
+} // anonymous namespace
+
+/////////////////////////////////////////////////////////////////////////////////
+
+python::list CountingBreakpoint::getCallers()
+{
+    std::vector<CallerRow>  rows;
+
+    do {
+        AutoRestorePyState  pystate;
+
+        CallerCounts  callers;
+        {
+            boost::mutex::scoped_lock  lock(m_lock);
+            callers = m_callers;
+        }
+
+        rows = getCallerRows(callers);
+
+    } while(false);
+
+    python::list  lst;
+    for ( size_t i = 0; i < rows.size(); ++i )
+        lst.append( python::make_tuple( rows[i].caller, rows[i].count, rows[i].symbol ) );
+
+    return lst;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+
+void CountingBreakpoint::reset()
+{
+    AutoRestorePyState  pystate;
+    boost::mutex::scoped_lock  lock(m_lock);
+
+    m_hitCount = 0;
+    m_threadCounts.clear();
+    m_callers.clear();
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+
+std::wstring CountingBreakpoint::print()
+{
+    AutoRestorePyState  pystate;
+
+    unsigned long long  hitCount;
+    ThreadCounts  threadCounts;
+    CallerCounts  callers;
+
+    {
+        boost::mutex::scoped_lock  lock(m_lock);
+        hitCount = m_hitCount;
+        threadCounts = m_threadCounts;
+        callers = m_callers;
+    }
+
+    std::wstringstream  sstr;
+
+    sstr << L"Hits: " << std::dec << hitCount << std::endl;
+
+    for ( ThreadCounts::const_iterator it = threadCounts.begin(); it != threadCounts.end(); ++it )
+        sstr << L"    Thread: " << std::hex << it->first << L"  " << std::dec << it->second << std::endl;
+
+    if ( m_sampleRate != 0 )
+    {
+        sstr << L"Callers (1 of " << std::dec << m_sampleRate << L" hits):" << std::endl;
+
+        std::vector<CallerRow>  rows = getCallerRows(callers);
+        for ( size_t i = 0; i < rows.size(); ++i )
+            sstr << L"    " << std::dec << rows[i].count << L"  " << std::hex << rows[i].caller << L"  " << rows[i].symbol << std::endl;
+    }
+
+    return sstr.str();
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+
+CountingBreakpoint* CountingBreakpoint::setCountingBreakpoint( kdlib::MEMOFFSET_64 offset, unsigned long sampleRate, const std::wstring& condition )
+{
+    return new CountingBreakpoint(offset, sampleRate, condition);
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+
+TraceBreakpoint::TraceBreakpoint( kdlib::MEMOFFSET_64 offset, const python::list& spec, size_t capacity, const std::wstring& condition ) :
+    m_recordSize( headerSize ),
+    m_capacity( capacity ),
+    m_hitCount( 0 )
+{
+    if ( capacity == 0 )
+        throw kdlib::DbgException("Trace buffer capacity must not be zero");
+
+    for ( long i = 0; i < python::len(spec); ++i )
+    {
+        TraceItem  item;
+
+        python::extract<std::wstring>  text( spec[i] );
+        if ( text.check() )
+        {
+            item.text = text();
+            item.size = sizeof(unsigned long long);
+            item.memory = false;
+        }
+        else
+        {
+            python::tuple  memoryItem = python::extract<python::tuple>( spec[i] );
+            item.text = python::extract<std::wstring>( memoryItem[0] );
+            item.size = python::extract<size_t>( memoryItem[1] );
+            item.memory = true;
+
+            if ( item.size == 0 )
+                throw kdlib::DbgException("Trace memory item size must not be zero");
+        }
+
+        item.offset = m_recordSize;
+        m_recordSize += item.size;
+
+        m_items.push_back(item);
+    }
+
+    AutoRestorePyState  pystate;
+
+    for ( std::vector<TraceItem>::iterator it = m_items.begin(); it != m_items.end(); ++it )
+        it->expression = NativeExpressionPtr( new NativeExpression(it->text) );
+
+    if ( !condition.empty() )
+        m_condition = NativeExpressionPtr( new NativeExpression(condition) );
+
+    m_buffer.resize( m_recordSize * m_capacity );
+
+    m_breakpoint = kdlib::softwareBreakPointSet(offset, this);
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+
+TraceBreakpoint::~TraceBreakpoint()
+{
+    AutoRestorePyState  pystate;
+    if ( m_breakpoint )
+    {
+        m_breakpoint->remove();
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+
+kdlib::DebugCallbackResult TraceBreakpoint::onHit()
+{
+    kdlib::THREAD_ID  tid = 0;
+
+    try {
+
+        if ( m_condition && m_condition->evaluate() == 0 )
+            return kdlib::DebugCallbackProceed;
+
+        tid = kdlib::getThreadSystemId(-1);
+    }
+    catch (const kdlib::DbgException&)
+    {
+        return kdlib::DebugCallbackProceed;
+    }
+
+    boost::mutex::scoped_lock  lock(m_lock);
+
+    unsigned char*  record = &m_buffer[ static_cast<size_t>( m_hitCount % m_capacity ) * m_recordSize ];
+
+    unsigned long long  header[2] = { m_hitCount, tid };
+    memcpy( record, header, headerSize );
+
+    for ( std::vector<TraceItem>::const_iterator it = m_items.begin(); it != m_items.end(); ++it )
+    {
+        unsigned char*  field = record + it->offset;
+
+        try {
+
+            unsigned long long  value = it->expression->evaluate();
+
+            if ( !it->memory )
+            {
+                memcpy( field, &value, sizeof(value) );
+                continue;
+            }
+
+            std::vector<unsigned char>  bytes = kdlib::loadBytes( value, static_cast<unsigned long>(it->size) );
+            memcpy( field, &bytes[0], it->size );
+        }
+        catch (const kdlib::DbgException&)
+        {
+            memset( field, 0, it->size );
+        }
+    }
+
+    ++m_hitCount;
+
+    return kdlib::DebugCallbackProceed;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+
+kdlib::BREAKPOINT_ID TraceBreakpoint::getId() const
+{
+    AutoRestorePyState  pystate;
+
+    if ( !m_breakpoint )
+        throw kdlib::DbgException("Breakpoint is removed");
+
+    return m_breakpoint->getId();
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+
+kdlib::MEMOFFSET_64 TraceBreakpoint::getOffset() const
+{
+    AutoRestorePyState  pystate;
+
+    if ( !m_breakpoint )
+        throw kdlib::DbgException("Breakpoint is removed");
+
+    return m_breakpoint->getOffset();
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+
+void TraceBreakpoint::remove()
+{
+    AutoRestorePyState  pystate;
+    if (m_breakpoint)
+    {
+        m_breakpoint->remove();
+        m_breakpoint = 0;
+        return;
+    }
+
+    throw kdlib::DbgException("Cannot remove breakpoint, it is already removed");
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+
+python::list TraceBreakpoint::getLayout()
+{
+    python::list  lst;
+
+    lst.append( python::make_tuple( std::wstring(L"hit"), 0, sizeof(unsigned long long) ) );
+    lst.append( python::make_tuple( std::wstring(L"thread"), sizeof(unsigned long long), sizeof(unsigned long long) ) );
+
+    for ( std::vector<TraceItem>::const_iterator it = m_items.begin(); it != m_items.end(); ++it )
+        lst.append( python::make_tuple( it->text, it->offset, it->size ) );
+
+    return lst;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+
+unsigned long long TraceBreakpoint::getHitCount()
+{
+    AutoRestorePyState  pystate;
+    boost::mutex::scoped_lock  lock(m_lock);
+    return m_hitCount;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+
+size_t TraceBreakpoint::getRecordCount()
+{
+    AutoRestorePyState  pystate;
+    boost::mutex::scoped_lock  lock(m_lock);
+    return m_hitCount < m_capacity ? static_cast<size_t>(m_hitCount) : m_capacity;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+
+python::object TraceBreakpoint::getRecords()
+{
+    std::vector<unsigned char>  records;
+
+    do {
+
+        AutoRestorePyState  pystate;
+        boost::mutex::scoped_lock  lock(m_lock);
+
+        // the oldest record follows the last written one when the buffer is wrapped
+        size_t  count = m_hitCount < m_capacity ? static_cast<size_t>(m_hitCount) : m_capacity;
+        size_t  first = m_hitCount > m_capacity ? static_cast<size_t>( m_hitCount % m_capacity ) : 0;
+
+        records.reserve( count * m_recordSize );
+        records.insert( records.end(), m_buffer.begin() + first * m_recordSize, m_buffer.begin() + count * m_recordSize );
+        records.insert( records.end(), m_buffer.begin(), m_buffer.begin() + first * m_recordSize );
+
+    } while(false);
+
+    const char*  data = records.empty() ? "" : reinterpret_cast<const char*>( &records[0] );
+
+    return python::object( python::handle<>( PyByteArray_FromStringAndSize( data, records.size() ) ) );
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+
+void TraceBreakpoint::reset()
+{
+    AutoRestorePyState  pystate;
+    boost::mutex::scoped_lock  lock(m_lock);
+    m_hitCount = 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+
+TraceBreakpoint* TraceBreakpoint::setTraceBreakpoint( kdlib::MEMOFFSET_64 offset, const python::list& spec, size_t capacity, const std::wstring& condition )
+{
+    return new TraceBreakpoint(offset, spec, capacity, condition);
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+
+BreakpointRegistry& BreakpointRegistry::get()
+{
+    // never destroyed: the entries hold Python objects which must not be
+    // released after the interpreter is finalized
+    static BreakpointRegistry*  registry = new BreakpointRegistry();
+    return *registry;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+
+python::list BreakpointRegistry::setBreakpoints( const python::list& addresses, const python::object& callback )
+{
+    std::vector<kdlib::MEMOFFSET_64>  offsets;
+    for ( long i = 0; i < python::len(addresses); ++i )
+        offsets.push_back( python::extract<kdlib::MEMOFFSET_64>( addresses[i] ) );
+
+    SharedCallbackPtr  sharedCallback( new SharedCallback() );
+    sharedCallback->callback = callback;
+    sharedCallback->pystate = PyThreadState_Get();
+
+    std::vector<EntryPtr>  removed;
+    std::vector<EntryPtr>  added;
+    std::vector<kdlib::BREAKPOINT_ID>  ids;
+    ids.reserve( offsets.size() );
+
+    do {
+
+        AutoRestorePyState  pystate;
+
+        {
+            boost::mutex::scoped_lock  lock(m_lock);
+            removed.swap( m_removed );
+        }
+
+        try {
+
+            for ( std::vector<kdlib::MEMOFFSET_64>::const_iterator it = offsets.begin(); it != offsets.end(); ++it )
+            {
+                {
+                    boost::mutex::scoped_lock  lock(m_lock);
+
+                    std::unordered_map<kdlib::MEMOFFSET_64, kdlib::BREAKPOINT_ID>::const_iterator  found = m_byOffset.find( *it );
+                    if ( found != m_byOffset.end() )
+                    {
+                        ids.push_back( found->second );
+                        continue;
+                    }
+                }
+
+                EntryPtr  entry( new Entry( this, sharedCallback, *it ) );
+                entry->m_breakpoint = kdlib::softwareBreakPointSet( *it, entry.get() );
+                entry->m_id = entry->m_breakpoint->getId();
+
+                boost::mutex::scoped_lock  lock(m_lock);
+                m_byId[ entry->m_id ] = entry;
+                m_byOffset[ *it ] = entry->m_id;
+                ids.push_back( entry->m_id );
+                added.push_back( entry );
+            }
+        }
+        catch ( const kdlib::DbgException& )
+        {
+            // the ids are not returned, so the breakpoints set by this call are removed
+            {
+                boost::mutex::scoped_lock  lock(m_lock);
+
+                for ( std::vector<EntryPtr>::const_iterator it = added.begin(); it != added.end(); ++it )
+                {
+                    m_byOffset.erase( (*it)->m_offset );
+                    m_byId.erase( (*it)->m_id );
+                }
+            }
+
+            for ( std::vector<EntryPtr>::const_iterator it = added.begin(); it != added.end(); ++it )
+            {
+                try {
+                    kdlib::BreakpointPtr  bp = (*it)->m_breakpoint;
+                    if ( bp )
+                        bp->remove();
+                }
+                catch ( const kdlib::DbgException& )
+                {}
+            }
+
+            throw;
+        }
+
+    } while(false);
+
+    python::list  lst;
+    for ( size_t i = 0; i < ids.size(); ++i )
+        lst.append( ids[i] );
+
+    return lst;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+
+void BreakpointRegistry::removeBreakpoints( const python::list& ids )
+{
+    std::vector<kdlib::BREAKPOINT_ID>  bpIds;
+    for ( long i = 0; i < python::len(ids); ++i )
+        bpIds.push_back( python::extract<kdlib::BREAKPOINT_ID>( ids[i] ) );
+
+    // entries removed by the engine already, only released here
+    std::vector<EntryPtr>  released;
+    std::vector<EntryPtr>  removed;
+
+    do {
+
+        AutoRestorePyState  pystate;
+
+        {
+            boost::mutex::scoped_lock  lock(m_lock);
+
+            released.swap( m_removed );
+
+            for ( std::vector<kdlib::BREAKPOINT_ID>::const_iterator it = bpIds.begin(); it != bpIds.end(); ++it )
+            {
+                std::unordered_map<kdlib::BREAKPOINT_ID, EntryPtr>::iterator  found = m_byId.find( *it );
+                if ( found == m_byId.end() )
+                    continue;
+
+                removed.push_back( found->second );
+                m_byOffset.erase( found->second->m_offset );
+                m_byId.erase( found );
+            }
+        }
+
+        // the entries are out of the maps already, so onRemove does nothing
+        for ( std::vector<EntryPtr>::const_iterator it = removed.begin(); it != removed.end(); ++it )
+        {
+            kdlib::BreakpointPtr  bp = (*it)->m_breakpoint;
+            if ( bp )
+                bp->remove();
+        }
+
+    } while(false);
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+
+python::object BreakpointRegistry::findBreakpoint( kdlib::MEMOFFSET_64 offset )
+{
+    kdlib::BREAKPOINT_ID  id;
+
+    do {
+
+        AutoRestorePyState  pystate;
+        boost::mutex::scoped_lock  lock(m_lock);
+
+        std::unordered_map<kdlib::MEMOFFSET_64, kdlib::BREAKPOINT_ID>::const_iterator  found = m_byOffset.find( offset );
+        if ( found == m_byOffset.end() )
+            return python::object();
+
+        id = found->second;
+
+    } while(false);
+
+    return python::object( id );
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+
+python::list BreakpointRegistry::getBreakpoints()
+{
+    std::vector< std::pair<kdlib::BREAKPOINT_ID, kdlib::MEMOFFSET_64> >  breakpoints;
+
+    do {
+
+        AutoRestorePyState  pystate;
+        boost::mutex::scoped_lock  lock(m_lock);
+
+        breakpoints.reserve( m_byId.size() );
+        for ( std::unordered_map<kdlib::BREAKPOINT_ID, EntryPtr>::const_iterator it = m_byId.begin(); it != m_byId.end(); ++it )
+            breakpoints.push_back( std::make_pair( it->first, it->second->m_offset ) );
+
+    } while(false);
+
+    std::sort( breakpoints.begin(), breakpoints.end() );
+
+    python::list  lst;
+    for ( size_t i = 0; i < breakpoints.size(); ++i )
+        lst.append( python::make_tuple( breakpoints[i].first, breakpoints[i].second ) );
+
+    return lst;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+
+void BreakpointRegistry::onRemoved( Entry* entry )
+{
+    boost::mutex::scoped_lock  lock(m_lock);
+
+    std::unordered_map<kdlib::BREAKPOINT_ID, EntryPtr>::iterator  found = m_byId.find( entry->m_id );
+    if ( found == m_byId.end() || found->second.get() != entry )
+        return;
+
+    // the engine breakpoint is gone, it must not be removed once more
+    entry->m_breakpoint = 0;
+
+    m_removed.push_back( found->second );
+    m_byOffset.erase( entry->m_offset );
+    m_byId.erase( found );
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+
+kdlib::DebugCallbackResult BreakpointRegistry::Entry::onHit()
+{
+    SharedCallbackPtr  sharedCallback = m_callback;
+
+    if ( sharedCallback->callback.is_none() )
+        return kdlib::DebugCallbackBreak;
+
+    kdlib::DebugCallbackResult  result = kdlib::DebugCallbackNoChange;
+
+    PyEval_RestoreThread( sharedCallback->pystate );
+
+    try {
+
+        do {
+
+            python::object  resObj = sharedCallback->callback( m_id );
+
+            if (resObj.is_none())
+            {
+                result = kdlib::DebugCallbackProceed;
+                break;
+            }
+
+            if (PyBool_Check(resObj.ptr()))
+            {
+                result = python::extract<bool>(resObj) ? kdlib::DebugCallbackBreak : kdlib::DebugCallbackProceed;
+                break;
+            }
+
+            python::extract<int>  resInt(resObj);
+            if (resInt.check())
+            {
+                result = resInt < kdlib::DebugCallbackMax ? kdlib::DebugCallbackResult(resInt()) : kdlib::DebugCallbackBreak;
+                break;
+            }
+
+            result = kdlib::DebugCallbackBreak;
+
+        } while( FALSE );
+    }
+    catch (const python::error_already_set &)
+    {
+        printException();
+        result =  kdlib::DebugCallbackBreak;
+    }
+
+    sharedCallback->pystate = saveThreadFlushed();
+
+    return result;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+
+void BreakpointRegistry::Entry::onRemove()
+{
+    m_registry->onRemoved( this );
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+
+void BreakpointRegistry::removeInterpreterBreakpoints( PyInterpreterState* interpreter )
+{
+    python::list  ids;
+
+    do {
+
+        boost::mutex::scoped_lock  lock(m_lock);
+
+        for ( std::unordered_map<kdlib::BREAKPOINT_ID, EntryPtr>::const_iterator it = m_byId.begin(); it != m_byId.end(); ++it )
+        {
+            if ( it->second->m_callback->pystate->interp == interpreter )
+                ids.append( it->first );
+        }
+
+    } while(false);
+
+    // the entries already removed by the engine are released here as well
+    removeBreakpoints( ids );
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+
+size_t getPythonCallbackCount( PyInterpreterState* interpreter )
+{
+    std::map<PyInterpreterState*, size_t>::const_iterator  found = g_pythonCallbacks.find( interpreter );
+    return found != g_pythonCallbacks.end() ? found->second : 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
 
 } // end namespace pykd
@@ -1,8 +1,12 @@
 #pragma once    
 
+#include <deque>
 #include <map>
+#include <unordered_map>
+#include <vector>
 
 #include <boost/thread/recursive_mutex.hpp>
+#include <boost/thread/mutex.hpp>
 
 #include "kdlib/dbgengine.h"
 #include "kdlib/eventhandler.h"
@@ -12,8 +16,12 @@
 #include "boost/noncopyable.hpp"
 #include "boost/python/object.hpp"
 #include "boost/python/wrapper.hpp"
+#include "boost/python/list.hpp"
+#include "boost/python/dict.hpp"
+#include "boost/python/tuple.hpp"
 
 #include "pythreadstate.h"
+#include "pyexpression.h"
 
 namespace python = boost::python;
 
@@ -28,6 +36,8 @@ public:
 
     EventHandler();
 
+    ~EventHandler();
+
     kdlib::DebugCallbackResult onBreakpoint( kdlib::BREAKPOINT_ID bpId ) override;
     kdlib::DebugCallbackResult onException( const kdlib::ExceptionInfo &exceptionInfo ) override;
     kdlib::DebugCallbackResult onModuleLoad( kdlib::MEMOFFSET_64 offset, const std::wstring &name ) override;
@@ -44,9 +54,73 @@ public:
     void onStartInput() override;
     void onStopInput() override;
 
+    // In the queued mode notification events (all but breakpoints and exceptions)
+    // are copied into a native queue instead of calling Python from the engine
+    // callback. They are delivered to onEvents(list) or, without it, to the
+    // separate handlers: on flushEvents, when the target stops and, if batchSize
+    // is not zero, when batchSize events are queued. Queued module and thread
+    // events can not break the target. At most capacity events are kept, the
+    // oldest ones are dropped and counted
+    void setQueuedMode( bool queued, size_t batchSize = 0, size_t capacity = 0x10000 );
+
+    void flushEvents();
+
+    unsigned long long getDroppedEvents();
+
 private:
 
+    enum HandlerId {
+        OnBreakpointHandler = 1 << 0,
+        OnExceptionHandler = 1 << 1,
+        OnLoadModuleHandler = 1 << 2,
+        OnUnloadModuleHandler = 1 << 3,
+        OnThreadStartHandler = 1 << 4,
+        OnThreadStopHandler = 1 << 5,
+        OnExecutionStatusChangeHandler = 1 << 6,
+        OnCurrentThreadChangeHandler = 1 << 7,
+        OnChangeLocalScopeHandler = 1 << 8,
+        OnChangeSymbolPathsHandler = 1 << 9,
+        OnChangeBreakpointsHandler = 1 << 10,
+        OnDebugOutputHandler = 1 << 11,
+        OnStartInputHandler = 1 << 12,
+        OnStopInputHandler = 1 << 13,
+        OnEventsHandler = 1 << 14
+    };
+
+    struct QueuedEvent {
+        HandlerId  handler;
+        kdlib::MEMOFFSET_64  offset;
+        unsigned long long  value;
+        std::wstring  text;
+    };
+
+    static const char* getHandlerName( HandlerId handler );
+
+    static python::tuple eventToTuple( const QueuedEvent& event );
+
+    bool hasOverride( HandlerId handler );
+
+    bool queueEvent( HandlerId handler, kdlib::MEMOFFSET_64 offset = 0, unsigned long long value = 0, const std::wstring& text = std::wstring() );
+
+    void deliverEvents();
+
     PyThreadState*  m_pystate;
+
+    unsigned long  m_overrides;
+
+    bool  m_overridesResolved;
+
+    bool  m_queued;
+
+    size_t  m_batchSize;
+
+    size_t  m_capacity;
+
+    unsigned long long  m_dropped;
+
+    boost::mutex  m_queueLock;
+
+    std::deque<QueuedEvent>  m_queue;
 };
 
 /////////////////////////////////////////////////////////////////////////////////
@@ -57,9 +131,9 @@ class Breakpoint : public python::wrapper<kdlib::BreakpointCallback>, public kdl
 
 public:
 
-    static Breakpoint* setSoftwareBreakpoint( kdlib::MEMOFFSET_64 offset, python::object  &callback = python::object() );
+    static Breakpoint* setSoftwareBreakpoint( kdlib::MEMOFFSET_64 offset, python::object  &callback = python::object(), const std::wstring& condition = L"" );
 
-    static Breakpoint* setHardwareBreakpoint( kdlib::MEMOFFSET_64 offset, size_t size, kdlib::ACCESS_TYPE accessType, python::object  &callback= python::object() );
+    static Breakpoint* setHardwareBreakpoint( kdlib::MEMOFFSET_64 offset, size_t size, kdlib::ACCESS_TYPE accessType, python::object  &callback= python::object(), const std::wstring& condition = L"" );
 
     static unsigned long getNumberBreakpoints();
 
@@ -107,6 +181,12 @@ public:
 
     Breakpoint* detach();
 
+    // the condition is evaluated natively on each hit, the callback is called
+    // only if it is not zero; an empty string removes the condition
+    void setCondition( const std::wstring& condition );
+
+    std::wstring getCondition() const;
+
 private:
 
     PyThreadState*  m_pystate;
@@ -115,9 +195,263 @@ private:
 
     python::object  m_callback;
 
+    NativeExpressionPtr  m_condition;
+
     bool m_weakBp;
+
+    // onHit is called by kdlib
+    bool m_hitCallback;
+};
+
+/////////////////////////////////////////////////////////////////////////////////
+
+// Breakpoint which never enters Python: it counts hits in total and per thread
+// and, if sampleRate is not zero, records the caller of every sampleRate-th hit.
+// The caller is the return address on the top of the stack, so the breakpoint
+// is expected to be set on a function entry
+
+class CountingBreakpoint : public kdlib::BreakpointCallback, private boost::noncopyable
+{
+
+public:
+
+    static CountingBreakpoint* setCountingBreakpoint( kdlib::MEMOFFSET_64 offset, unsigned long sampleRate = 0, const std::wstring& condition = L"" );
+
+public:
+
+    CountingBreakpoint( kdlib::MEMOFFSET_64 offset, unsigned long sampleRate, const std::wstring& condition );
+
+    ~CountingBreakpoint();
+
+    virtual kdlib::DebugCallbackResult onHit();
+
+    virtual void onRemove()
+    {
+        m_breakpoint = 0;
+    }
+
+    kdlib::BREAKPOINT_ID getId() const;
+
+    kdlib::MEMOFFSET_64 getOffset() const;
+
+    void remove();
+
+    unsigned long getSampleRate() const {
+        return m_sampleRate;
+    }
+
+    unsigned long long getHitCount();
+
+    python::dict getThreadCounts();
+
+    python::list getCallers();
+
+    void reset();
+
+    std::wstring print();
+
+private:
+
+    typedef std::map<kdlib::THREAD_ID, unsigned long long>  ThreadCounts;
+    typedef std::map<kdlib::MEMOFFSET_64, unsigned long long>  CallerCounts;
+
+    kdlib::BreakpointPtr  m_breakpoint;
+
+    unsigned long  m_sampleRate;
+
+    NativeExpressionPtr  m_condition;
+
+    boost::mutex  m_lock;
+
+    unsigned long long  m_hitCount;
+
+    ThreadCounts  m_threadCounts;
+
+    CallerCounts  m_callers;
 };
 
+/////////////////////////////////////////////////////////////////////////////////
+
+// Breakpoint which never enters Python: on each hit it writes a fixed size
+// record into a ring buffer. The spec is a list of items:
+//   "expression" - 8 byte value of a native expression ("rcx", "poi(rsp+8)")
+//   ("expression", size) - size bytes of memory at the expression's address
+// Every record starts with the hit number and the thread system id (8 bytes
+// each), the items follow in the spec order. Unreadable memory is zero filled.
+// When the buffer is full the oldest records are overwritten
+
+class TraceBreakpoint : public kdlib::BreakpointCallback, private boost::noncopyable
+{
+
+public:
+
+    static TraceBreakpoint* setTraceBreakpoint( kdlib::MEMOFFSET_64 offset, const python::list& spec, size_t capacity = 0x1000, const std::wstring& condition = L"" );
+
+public:
+
+    TraceBreakpoint( kdlib::MEMOFFSET_64 offset, const python::list& spec, size_t capacity, const std::wstring& condition );
+
+    ~TraceBreakpoint();
+
+    virtual kdlib::DebugCallbackResult onHit();
+
+    virtual void onRemove()
+    {
+        m_breakpoint = 0;
+    }
+
+    kdlib::BREAKPOINT_ID getId() const;
+
+    kdlib::MEMOFFSET_64 getOffset() const;
+
+    void remove();
+
+    size_t getRecordSize() const {
+        return m_recordSize;
+    }
+
+    size_t getCapacity() const {
+        return m_capacity;
+    }
+
+    python::list getLayout();
+
+    unsigned long long getHitCount();
+
+    size_t getRecordCount();
+
+    python::object getRecords();
+
+    void reset();
+
+private:
+
+    struct TraceItem {
+        std::wstring  text;
+        NativeExpressionPtr  expression;
+        size_t  offset;
+        size_t  size;
+        bool  memory;
+    };
+
+    static const size_t  headerSize = 2 * sizeof(unsigned long long);
+
+    kdlib::BreakpointPtr  m_breakpoint;
+
+    NativeExpressionPtr  m_condition;
+
+    std::vector<TraceItem>  m_items;
+
+    size_t  m_recordSize;
+
+    size_t  m_capacity;
+
+    boost::mutex  m_lock;
+
+    unsigned long long  m_hitCount;
+
+    std::vector<unsigned char>  m_buffer;
+};
+
+
+/////////////////////////////////////////////////////////////////////////////////
+
+// Breakpoints set in bulk and found by id or address without walking the
+// kdlib breakpoint list. All breakpoints of one setBreakpoints call share
+// one Python callback, it is called with the breakpoint id. Without a
+// callback the breakpoints always break
+
+class BreakpointRegistry : private boost::noncopyable
+{
+
+public:
+
+    static BreakpointRegistry& get();
+
+    python::list setBreakpoints( const python::list& addresses, const python::object& callback );
+
+    void removeBreakpoints( const python::list& ids );
+
+    python::object findBreakpoint( kdlib::MEMOFFSET_64 offset );
+
+    python::list getBreakpoints();
+
+    // removes the breakpoints calling back into the interpreter
+    void removeInterpreterBreakpoints( PyInterpreterState* interpreter );
+
+private:
+
+    struct SharedCallback {
+        python::object  callback;
+        PyThreadState*  pystate;
+    };
+
+    typedef boost::shared_ptr<SharedCallback>  SharedCallbackPtr;
+
+    class Entry : public kdlib::BreakpointCallback
+    {
+    public:
+
+        Entry( BreakpointRegistry* registry, const SharedCallbackPtr& callback, kdlib::MEMOFFSET_64 offset ) :
+            m_registry( registry ),
+            m_callback( callback ),
+            m_id( 0 ),
+            m_offset( offset )
+        {}
+
+        virtual kdlib::DebugCallbackResult onHit();
+
+        virtual void onRemove();
+
+        BreakpointRegistry*  m_registry;
+        SharedCallbackPtr  m_callback;
+        kdlib::BreakpointPtr  m_breakpoint;
+        kdlib::BREAKPOINT_ID  m_id;
+        kdlib::MEMOFFSET_64  m_offset;
+    };
+
+    typedef boost::shared_ptr<Entry>  EntryPtr;
+
+    BreakpointRegistry() {}
+
+    void onRemoved( Entry* entry );
+
+    boost::mutex  m_lock;
+
+    std::unordered_map<kdlib::BREAKPOINT_ID, EntryPtr>  m_byId;
+    std::unordered_map<kdlib::MEMOFFSET_64, kdlib::BREAKPOINT_ID>  m_byOffset;
+
+    // entries removed by the engine are released later with the GIL held,
+    // they keep references to the Python callbacks
+    std::vector<EntryPtr>  m_removed;
+};
+
+inline python::list setBreakpoints( const python::list& addresses, const python::object& callback = python::object() )
+{
+    return BreakpointRegistry::get().setBreakpoints( addresses, callback );
+}
+
+inline void removeBreakpoints( const python::list& ids )
+{
+    BreakpointRegistry::get().removeBreakpoints( ids );
+}
+
+inline python::object findBreakpoint( kdlib::MEMOFFSET_64 offset )
+{
+    return BreakpointRegistry::get().findBreakpoint( offset );
+}
+
+inline python::list getRegisteredBreakpoints()
+{
+    return BreakpointRegistry::get().getBreakpoints();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Number of event handlers and breakpoint objects alive in the interpreter
+// whose callbacks call Python. The GIL must be held
+
+size_t getPythonCallbackCount( PyInterpreterState* interpreter );
 
 ///////////////////////////////////////////////////////////////////////////////
 
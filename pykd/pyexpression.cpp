@@ -0,0 +1,512 @@
+#include "stdafx.h"
+
+#include <cwctype>
+#include <sstream>
+
+#include <dbgeng.h>
+
+#include "kdlib/cpucontext.h"
+#include "kdlib/memaccess.h"
+#include "kdlib/exceptions.h"
+
+#include "pyexpression.h"
+
+namespace pykd {
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+// the radix of numbers without a prefix, set with the "n" command
+unsigned long getEngineRadix()
+{
+    ULONG  radix = 16;
+
+    IDebugClient5*  client = 0;
+    if ( FAILED( DebugCreate( __uuidof(IDebugClient5), reinterpret_cast<void**>( &client ) ) ) )
+        return radix;
+
+    IDebugControl*  control = 0;
+    if ( SUCCEEDED( client->QueryInterface( __uuidof(IDebugControl), reinterpret_cast<void**>( &control ) ) ) )
+    {
+        ULONG  engineRadix;
+        if ( SUCCEEDED( control->GetRadix( &engineRadix ) ) )
+            radix = engineRadix;
+
+        control->Release();
+    }
+
+    client->Release();
+
+    return radix;
+}
+
+} // anonymous namespace
+
+///////////////////////////////////////////////////////////////////////////////
+
+class NativeExpression::Parser {
+
+public:
+
+    Parser( const std::wstring& text, std::vector<Op>& program ) :
+        m_text( text ),
+        m_pos( 0 ),
+        m_radix( getEngineRadix() ),
+        m_program( program ),
+        m_depth( 0 ),
+        m_maxDepth( 0 )
+    {}
+
+    size_t parse()
+    {
+        parseBinary(0);
+
+        skipSpaces();
+        if ( m_pos != m_text.size() )
+            syntaxError();
+
+        return m_maxDepth;
+    }
+
+private:
+
+    struct BinaryOp {
+        const wchar_t*  token;
+        OpCode  code;
+        int  level;
+    };
+
+    // the longer tokens go first: "<=" must not be taken for "<"
+    static const BinaryOp* binaryOps()
+    {
+        static const BinaryOp  ops[] = {
+            { L"||", OpOrJump, 0 },
+            { L"&&", OpAndJump, 1 },
+            { L"==", OpEqual, 5 },
+            { L"!=", OpNotEqual, 5 },
+            { L"<=", OpLessEq, 6 },
+            { L">=", OpGreaterEq, 6 },
+            { L"<<", OpShl, 7 },
+            { L">>", OpShr, 7 },
+            { L"|", OpBitOr, 2 },
+            { L"^", OpBitXor, 3 },
+            { L"&", OpBitAnd, 4 },
+            { L"<", OpLess, 6 },
+            { L">", OpGreater, 6 },
+            { L"+", OpAdd, 8 },
+            { L"-", OpSub, 8 },
+            { L"*", OpMul, 9 },
+            { L"/", OpDiv, 9 },
+            { L"%", OpMod, 9 },
+            { 0 }
+        };
+
+        return ops;
+    }
+
+    static const int  maxLevel = 9;
+
+    void parseBinary( int level )
+    {
+        if ( level > maxLevel )
+        {
+            parseUnary();
+            return;
+        }
+
+        parseBinary( level + 1 );
+
+        while ( true )
+        {
+            const BinaryOp*  op = matchBinary(level);
+            if ( !op )
+                break;
+
+            if ( op->code == OpAndJump || op->code == OpOrJump )
+            {
+                // the right operand is skipped if the left one decides the result
+                size_t  jump = m_program.size();
+                emit( op->code, 0, -1 );
+
+                parseBinary( level + 1 );
+                emit( OpToBool, 0, 0 );
+
+                m_program[jump].value = m_program.size();
+                continue;
+            }
+
+            parseBinary( level + 1 );
+            emit( op->code, 0, -1 );
+        }
+    }
+
+    const BinaryOp* matchBinary( int level )
+    {
+        skipSpaces();
+
+        for ( const BinaryOp* op = binaryOps(); op->token; ++op )
+        {
+            size_t  len = wcslen(op->token);
+            if ( m_text.compare( m_pos, len, op->token ) != 0 )
+                continue;
+
+            // the first matching token is the longest one, it may be of another level
+            if ( op->level != level )
+                return 0;
+
+            m_pos += len;
+            return op;
+        }
+
+        return 0;
+    }
+
+    void parseUnary()
+    {
+        skipSpaces();
+
+        if ( m_pos < m_text.size() )
+        {
+            wchar_t  ch = m_text[m_pos];
+            OpCode  code;
+
+            if ( ch == L'-' )
+                code = OpNeg;
+            else if ( ch == L'!' )
+                code = OpNot;
+            else if ( ch == L'~' )
+                code = OpBitNot;
+            else
+            {
+                parsePrimary();
+                return;
+            }
+
+            ++m_pos;
+            parseUnary();
+            emit( code, 0, 0 );
+            return;
+        }
+
+        parsePrimary();
+    }
+
+    void parsePrimary()
+    {
+        skipSpaces();
+
+        if ( m_pos >= m_text.size() )
+            syntaxError();
+
+        wchar_t  ch = m_text[m_pos];
+
+        if ( ch == L'(' )
+        {
+            ++m_pos;
+            parseBinary(0);
+            expect(L')');
+            return;
+        }
+
+        if ( iswdigit(ch) )
+        {
+            emit( OpConst, parseNumber(), 1 );
+            return;
+        }
+
+        if ( ch == L'@' || ch == L'$' || ch == L'_' || iswalpha(ch) )
+        {
+            parseName();
+            return;
+        }
+
+        syntaxError();
+    }
+
+    // masm numbers: the engine radix or a 0x, 0n, 0t, 0y prefix (hex, decimal,
+    // octal, binary), digits may be separated with `
+    unsigned long long parseNumber()
+    {
+        unsigned long  base = m_radix;
+
+        if ( m_text[m_pos] == L'0' && m_pos + 1 < m_text.size() )
+        {
+            switch ( towlower( m_text[m_pos + 1] ) )
+            {
+            case L'x': base = 16; m_pos += 2; break;
+            case L'n': base = 10; m_pos += 2; break;
+            case L't': base = 8; m_pos += 2; break;
+            case L'y': base = 2; m_pos += 2; break;
+            }
+        }
+
+        size_t  start = m_pos;
+        unsigned long long  value = 0;
+
+        while ( m_pos < m_text.size() && ( iswxdigit( m_text[m_pos] ) || ( m_text[m_pos] == L'`' && m_pos > start ) ) )
+        {
+            if ( m_text[m_pos] == L'`' )
+            {
+                ++m_pos;
+                continue;
+            }
+
+            wchar_t  ch = towlower( m_text[m_pos] );
+            unsigned  digit = iswdigit(ch) ? ch - L'0' : ch - L'a' + 10;
+            if ( digit >= base )
+                syntaxError();
+
+            value = value * base + digit;
+            ++m_pos;
+        }
+
+        if ( m_pos == start || m_text[m_pos - 1] == L'`' )
+            syntaxError();
+
+        return value;
+    }
+
+    void parseName()
+    {
+        bool  forceRegister = m_text[m_pos] == L'@';
+        if ( forceRegister )
+            ++m_pos;
+
+        size_t  start = m_pos;
+        while ( m_pos < m_text.size() &&
+            ( iswalnum( m_text[m_pos] ) || m_text[m_pos] == L'_' || m_text[m_pos] == L'$' || m_text[m_pos] == L':' ||
+              ( m_text[m_pos] == L'!' && m_text.compare( m_pos, 2, L"!=" ) != 0 ) ) )
+        {
+            ++m_pos;
+        }
+
+        std::wstring  name = m_text.substr( start, m_pos - start );
+        if ( name.empty() )
+            syntaxError();
+
+        skipSpaces();
+
+        if ( !forceRegister && m_pos < m_text.size() && m_text[m_pos] == L'(' )
+        {
+            OpCode  code;
+            if ( name == L"poi" )
+                code = OpLoadPtr;
+            else if ( name == L"by" )
+                code = OpLoadByte;
+            else if ( name == L"wo" )
+                code = OpLoadWord;
+            else if ( name == L"dwo" )
+                code = OpLoadDWord;
+            else if ( name == L"qwo" )
+                code = OpLoadQWord;
+            else
+                syntaxError();
+
+            ++m_pos;
+            parseBinary(0);
+            expect(L')');
+            emit( code, 0, 0 );
+            return;
+        }
+
+        unsigned long  registerIndex;
+        if ( findRegister( name, registerIndex ) )
+        {
+            emit( OpRegister, registerIndex, 1 );
+            return;
+        }
+
+        if ( forceRegister )
+            throw kdlib::DbgException("expression refers to unknown register");
+
+        emit( OpConst, kdlib::getSymbolOffset(name), 1 );
+    }
+
+    static bool findRegister( const std::wstring& name, unsigned long& index )
+    {
+        unsigned long  registerNumber = kdlib::getRegisterNumber();
+
+        for ( unsigned long i = 0; i < registerNumber; ++i )
+        {
+            if ( _wcsicmp( kdlib::getRegisterName(i).c_str(), name.c_str() ) == 0 )
+            {
+                index = i;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void expect( wchar_t ch )
+    {
+        skipSpaces();
+        if ( m_pos >= m_text.size() || m_text[m_pos] != ch )
+            syntaxError();
+        ++m_pos;
+    }
+
+    void skipSpaces()
+    {
+        while ( m_pos < m_text.size() && iswspace( m_text[m_pos] ) )
+            ++m_pos;
+    }
+
+    void emit( OpCode code, unsigned long long value, int stackChange )
+    {
+        Op  op = { code, value };
+        m_program.push_back(op);
+
+        m_depth += stackChange;
+        if ( m_depth > m_maxDepth )
+            m_maxDepth = m_depth;
+    }
+
+    void syntaxError()
+    {
+        std::stringstream  sstr;
+        sstr << "expression syntax error at position " << m_pos;
+        throw kdlib::DbgException( sstr.str() );
+    }
+
+    const std::wstring&  m_text;
+    size_t  m_pos;
+    unsigned long  m_radix;
+    std::vector<Op>&  m_program;
+    long  m_depth;
+    long  m_maxDepth;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+NativeExpression::NativeExpression( const std::wstring& expression ) :
+    m_text( expression )
+{
+    m_stackSize = Parser( m_text, m_program ).parse();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+unsigned long long NativeExpression::evaluate() const
+{
+    static const size_t  localStackSize = 32;
+
+    unsigned long long  localStack[localStackSize];
+    std::vector<unsigned long long>  heapStack;
+
+    unsigned long long*  stack = localStack;
+    if ( m_stackSize > localStackSize )
+    {
+        heapStack.resize( m_stackSize );
+        stack = &heapStack[0];
+    }
+
+    size_t  top = 0;
+
+    for ( size_t pc = 0; pc < m_program.size(); ++pc )
+    {
+        const Op*  it = &m_program[pc];
+
+        switch ( it->code )
+        {
+        case OpConst:
+            stack[top++] = it->value;
+            continue;
+
+        case OpRegister:
+            stack[top++] = kdlib::getRegisterByIndex( static_cast<unsigned long>(it->value) ).asULongLong();
+            continue;
+
+        case OpLoadPtr:
+            stack[top - 1] = kdlib::ptrPtr( stack[top - 1] );
+            continue;
+
+        case OpLoadByte:
+            stack[top - 1] = kdlib::ptrByte( stack[top - 1] );
+            continue;
+
+        case OpLoadWord:
+            stack[top - 1] = kdlib::ptrWord( stack[top - 1] );
+            continue;
+
+        case OpLoadDWord:
+            stack[top - 1] = kdlib::ptrDWord( stack[top - 1] );
+            continue;
+
+        case OpLoadQWord:
+            stack[top - 1] = kdlib::ptrQWord( stack[top - 1] );
+            continue;
+
+        case OpNeg:
+            stack[top - 1] = 0 - stack[top - 1];
+            continue;
+
+        case OpNot:
+            stack[top - 1] = !stack[top - 1];
+            continue;
+
+        case OpBitNot:
+            stack[top - 1] = ~stack[top - 1];
+            continue;
+
+        case OpToBool:
+            stack[top - 1] = stack[top - 1] != 0;
+            continue;
+
+        case OpAndJump:
+            if ( stack[top - 1] == 0 )
+                pc = static_cast<size_t>(it->value) - 1;
+            else
+                --top;
+            continue;
+
+        case OpOrJump:
+            if ( stack[top - 1] != 0 )
+            {
+                stack[top - 1] = 1;
+                pc = static_cast<size_t>(it->value) - 1;
+            }
+            else
+                --top;
+            continue;
+
+        default:
+            break;
+        }
+
+        unsigned long long  right = stack[--top];
+        unsigned long long&  left = stack[top - 1];
+
+        switch ( it->code )
+        {
+        case OpMul: left *= right; break;
+        case OpDiv:
+        case OpMod:
+            if ( right == 0 )
+                throw kdlib::DbgException("expression division by zero");
+            left = it->code == OpDiv ? left / right : left % right;
+            break;
+        case OpAdd: left += right; break;
+        case OpSub: left -= right; break;
+        case OpShl: left = right < 64 ? left << right : 0; break;
+        case OpShr: left = right < 64 ? left >> right : 0; break;
+        case OpLess: left = left < right; break;
+        case OpLessEq: left = left <= right; break;
+        case OpGreater: left = left > right; break;
+        case OpGreaterEq: left = left >= right; break;
+        case OpEqual: left = left == right; break;
+        case OpNotEqual: left = left != right; break;
+        case OpBitAnd: left &= right; break;
+        case OpBitXor: left ^= right; break;
+        case OpBitOr: left |= right; break;
+        default: break;
+        }
+    }
+
+    return stack[0];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+} // end namespace pykd
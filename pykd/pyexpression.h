@@ -0,0 +1,86 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include "kdlib/dbgengine.h"
+
+namespace pykd {
+
+///////////////////////////////////////////////////////////////////////////////
+
+// C-like integer expression over registers, symbols and memory, parsed once
+// and evaluated without Python and without reparsing. Syntax:
+//   numbers: in the engine radix (hex unless changed with the n command),
+//     0x7b, 0n123, 0t173, 0y1111011 for the other radixes, ` separates digits
+//   registers: rcx, @rcx; symbols: module!name (resolved at compile time)
+//   memory: poi(x), by(x), wo(x), dwo(x), qwo(x)
+//   operators: unary - ! ~, * / %, + -, << >>, < <= > >=, == !=, &, ^, |, &&, ||
+//   (&& and || do not evaluate the right operand if the left one decides)
+// All arithmetic is unsigned 64 bit. Must be compiled and evaluated without the GIL
+
+class NativeExpression {
+
+public:
+
+    explicit NativeExpression( const std::wstring& expression );
+
+    unsigned long long evaluate() const;
+
+    const std::wstring& getText() const {
+        return m_text;
+    }
+
+private:
+
+    enum OpCode {
+        OpConst,
+        OpRegister,
+        OpLoadPtr,
+        OpLoadByte,
+        OpLoadWord,
+        OpLoadDWord,
+        OpLoadQWord,
+        OpNeg,
+        OpNot,
+        OpBitNot,
+        OpToBool,
+        OpAndJump,      // left operand of &&: jump to value if false
+        OpOrJump,       // left operand of ||: jump to value if true
+        OpMul,
+        OpDiv,
+        OpMod,
+        OpAdd,
+        OpSub,
+        OpShl,
+        OpShr,
+        OpLess,
+        OpLessEq,
+        OpGreater,
+        OpGreaterEq,
+        OpEqual,
+        OpNotEqual,
+        OpBitAnd,
+        OpBitXor,
+        OpBitOr
+    };
+
+    struct Op {
+        OpCode  code;
+        unsigned long long  value;
+    };
+
+    class Parser;
+
+    std::wstring  m_text;
+    std::vector<Op>  m_program;    // reverse polish notation, && and || are jumps
+    size_t  m_stackSize;
+};
+
+typedef boost::shared_ptr<NativeExpression>  NativeExpressionPtr;
+
+///////////////////////////////////////////////////////////////////////////////
+
+} // end namespace pykd
@@ -1,5 +1,10 @@
 #include "stdafx.h"
 
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+
 #include <boost/bind.hpp>
 
 #include "pykdver.h"
@@ -20,6 +25,10 @@
 #include "pytypeinfo.h"
 #include "pycpucontext.h"
 #include "pyprocess.h"
+#include "pystackwalk.h"
+#include "pyoutputcapture.h"
+#include "pycoverage.h"
+#include "pycancel.h"
 #include "pytagged.h"
 
 using namespace pykd;
@@ -79,6 +88,12 @@ BOOST_PYTHON_FUNCTION_OVERLOADS( getSourceFileFromSrcSrv_, pykd::getSourceFileFr
 BOOST_PYTHON_FUNCTION_OVERLOADS( getSourceLine_, pykd::getSourceLine, 0, 1 );
 BOOST_PYTHON_FUNCTION_OVERLOADS( findSymbol_, pykd::findSymbol, 1, 2 );
 BOOST_PYTHON_FUNCTION_OVERLOADS( getStack_, pykd::getStack, 0, 1);
+BOOST_PYTHON_FUNCTION_OVERLOADS( getStackTable_, pykd::getStackTable, 0, 1);
+
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS( OutputCapture_read, OutputCapture::read, 0, 1 );
+BOOST_PYTHON_FUNCTION_OVERLOADS( setProgress_, pykd::setProgress, 2, 3 );
+BOOST_PYTHON_FUNCTION_OVERLOADS( debugCommandStream_, pykd::debugCommandStream, 2, 5 );
+BOOST_PYTHON_FUNCTION_OVERLOADS( scanStack_, pykd::scanStack, 2, 3);
 
 BOOST_PYTHON_FUNCTION_OVERLOADS( getProcessOffset_, pykd::getProcessOffset, 0, 1);
 BOOST_PYTHON_FUNCTION_OVERLOADS( getProcessSystemId_, pykd::getProcessSystemId, 0, 1);
@@ -92,8 +107,10 @@ BOOST_PYTHON_FUNCTION_OVERLOADS( createStruct_, pykd::defineStruct, 1, 2 );
 BOOST_PYTHON_FUNCTION_OVERLOADS( createUnion_, pykd::defineUnion, 1, 2 );
 BOOST_PYTHON_FUNCTION_OVERLOADS( defineFunction_, pykd::defineFunction, 1, 2 );
 
-BOOST_PYTHON_FUNCTION_OVERLOADS( setSoftwareBreakpoint_, Breakpoint::setSoftwareBreakpoint, 1, 2 );
-BOOST_PYTHON_FUNCTION_OVERLOADS( setHardwareBreakpoint_, Breakpoint::setHardwareBreakpoint, 3, 4 );
+BOOST_PYTHON_FUNCTION_OVERLOADS( setSoftwareBreakpoint_, Breakpoint::setSoftwareBreakpoint, 1, 3 );
+BOOST_PYTHON_FUNCTION_OVERLOADS( setHardwareBreakpoint_, Breakpoint::setHardwareBreakpoint, 3, 5 );
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS( EventHandler_setQueuedMode, EventHandler::setQueuedMode, 1, 3 );
+BOOST_PYTHON_FUNCTION_OVERLOADS( setBreakpoints_, pykd::setBreakpoints, 1, 2 );
 
 BOOST_PYTHON_FUNCTION_OVERLOADS( TargetHeap_getEntries, TargetHeapAdapter::getEntries, 1, 4);
 
@@ -111,9 +128,11 @@ BOOST_PYTHON_FUNCTION_OVERLOADS( getSymbolProviderFromSource_, pykd::getSymbolPr
 BOOST_PYTHON_FUNCTION_OVERLOADS(evalExpr_, pykd::evalExpr, 1, 3);
 
 BOOST_PYTHON_FUNCTION_OVERLOADS( addSyntheticModule_, pykd::addSyntheticModule, 3, 4 );
+BOOST_PYTHON_FUNCTION_OVERLOADS( loadSyntheticSymbols_, pykd::loadSyntheticSymbols, 1, 2 );
 
 BOOST_PYTHON_FUNCTION_OVERLOADS(getDumpAccessor_, pykd::getDumpAccessor, 2, 3);
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(getDataAccessorNestedCopy_, kdlib::DataAccessorWrapper::nestedCopy, 1, 2);
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(FrameVarsDict_get, FrameVarsDict::get, 1, 2);
 
 namespace pykd {
 
@@ -137,11 +156,204 @@ void uninitialize()
 
 }
 
+//////////////////////////////////////////////////////////////////////////////////
+
+namespace pykd {
+
+// Time of the registration phases of the module init, the registration is the
+// most of the import cost
+
+static std::vector< std::pair<std::string, double> >  importProfile;
+
+class ImportProfiler {
+
+public:
+
+    ImportProfiler() :
+        m_phase( 0 )
+    {
+        importProfile.clear();
+    }
+
+    void phase( const char* name )
+    {
+        finish();
+        m_phase = name;
+        m_start = std::chrono::steady_clock::now();
+    }
+
+    void finish()
+    {
+        if ( !m_phase )
+            return;
+
+        std::chrono::duration<double>  elapsed = std::chrono::steady_clock::now() - m_start;
+        importProfile.push_back( std::make_pair( std::string(m_phase), elapsed.count() ) );
+        m_phase = 0;
+    }
+
+private:
+
+    const char*  m_phase;
+    std::chrono::steady_clock::time_point  m_start;
+};
+
+python::list getImportProfile()
+{
+    python::list  result;
+
+    for ( size_t i = 0; i < importProfile.size(); ++i )
+        result.append( python::make_tuple( importProfile[i].first, importProfile[i].second ) );
+
+    return result;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+
+// Classes of objects created only by factory functions are registered on the
+// first call of a factory instead of the import. A sub-interpreter gets a copy
+// of the module dict made at the first import, so the classes are added to the
+// module of the calling interpreter if it lacks them.
+// class_ puts converters into the global registry, which can not be repeated:
+// a registrar that failed is not run again, later calls report the failure.
+// Everything after it (finding the class objects, adding them to a module)
+// keeps no state until it succeeds and is retried on the next call
+
+class DeferredClasses {
+
+public:
+
+    DeferredClasses( void (*registrar)(), const char* const* names ) :
+        m_registrar( registrar ),
+        m_names( names ),
+        m_state( NotRegistered )
+    {}
+
+    void ensure()
+    {
+        python::object  module = python::import("pykd");
+
+        if ( m_state == RegistrationFailed )
+            throw kdlib::DbgException( std::string("failed to register class ") + m_names[0] );
+
+        if ( m_state == NotRegistered )
+        {
+            python::scope  moduleScope( module );
+
+            m_state = RegistrationFailed;
+            m_registrar();
+            m_state = Registered;
+        }
+
+        if ( m_classes.empty() )
+        {
+            std::vector<python::object>  classes;
+            for ( const char* const* name = m_names; *name; ++name )
+                classes.push_back( module.attr(*name) );
+
+            // class objects live until the process exit like their registrations
+            for ( size_t i = 0; i < classes.size(); ++i )
+                m_classes.push_back( python::incref( classes[i].ptr() ) );
+
+            return;
+        }
+
+        for ( size_t i = 0; i < m_classes.size(); ++i )
+        {
+            if ( !PyObject_HasAttrString( module.ptr(), m_names[i] ) )
+                module.attr( m_names[i] ) = python::object( python::handle<>( python::borrowed( m_classes[i] ) ) );
+        }
+    }
+
+private:
+
+    enum State {
+        NotRegistered,
+        Registered,
+        RegistrationFailed
+    };
+
+    void (*m_registrar)();
+    const char* const*  m_names;
+    State  m_state;
+    std::vector<PyObject*>  m_classes;
+};
+
+void registerStackWalkClasses();
+
+const char* const  stackWalkClassNames[] = { "stackWalkResult", "stackBuckets", 0 };
+
+DeferredClasses  stackWalkClasses( registerStackWalkClasses, stackWalkClassNames );
+
+void registerProbeClasses();
+
+const char* const  probeClassNames[] = { "countingBreakpoint", "traceBreakpoint", "codeCoverage", "outputCapture", 0 };
+
+DeferredClasses  probeClasses( registerProbeClasses, probeClassNames );
+
+StackWalkResultPtr walkAllStacksDeferred( const python::object& filter = python::object() )
+{
+    stackWalkClasses.ensure();
+    return walkAllStacks( filter );
+}
+
+StackBucketsPtr aggregateStacksDeferred( const StackWalkResultPtr& walkResult, bool normalize = false )
+{
+    stackWalkClasses.ensure();
+    return aggregateStacks( walkResult, normalize );
+}
+
+CountingBreakpoint* setCountingBreakpointDeferred( kdlib::MEMOFFSET_64 offset, unsigned long sampleRate = 0, const std::wstring& condition = L"" )
+{
+    probeClasses.ensure();
+    return CountingBreakpoint::setCountingBreakpoint( offset, sampleRate, condition );
+}
+
+TraceBreakpoint* setTraceBreakpointDeferred( kdlib::MEMOFFSET_64 offset, const python::list& spec, size_t capacity = 0x1000, const std::wstring& condition = L"" )
+{
+    probeClasses.ensure();
+    return TraceBreakpoint::setTraceBreakpoint( offset, spec, capacity, condition );
+}
+
+CodeCoveragePtr startCoverageDeferred( const python::list& addresses )
+{
+    probeClasses.ensure();
+    return startCoverage( addresses );
+}
+
+CodeCoveragePtr startFunctionCoverageDeferred( kdlib::Module& module )
+{
+    probeClasses.ensure();
+    return startFunctionCoverage( module );
+}
+
+OutputCapturePtr startOutputCaptureDeferred( const std::wstring& pattern = L"", bool isRegex = false, size_t capacity = 0x10000 )
+{
+    probeClasses.ensure();
+    return startOutputCapture( pattern, isRegex, capacity );
+}
+
+}
+
+BOOST_PYTHON_FUNCTION_OVERLOADS( walkAllStacks_, pykd::walkAllStacksDeferred, 0, 1);
+BOOST_PYTHON_FUNCTION_OVERLOADS( aggregateStacks_, pykd::aggregateStacksDeferred, 1, 2);
+BOOST_PYTHON_FUNCTION_OVERLOADS( setCountingBreakpoint_, pykd::setCountingBreakpointDeferred, 1, 3 );
+BOOST_PYTHON_FUNCTION_OVERLOADS( setTraceBreakpoint_, pykd::setTraceBreakpointDeferred, 2, 4 );
+BOOST_PYTHON_FUNCTION_OVERLOADS( startOutputCapture_, pykd::startOutputCaptureDeferred, 0, 3 );
+
+//////////////////////////////////////////////////////////////////////////////////
+
 void pykd_init()
 {
+    ImportProfiler  profiler;
+
+    profiler.phase("functions");
+
     python::scope().attr("__version__") = pykdVersion;
     python::scope().attr("version") = pykdVersion;
 
+    python::def( "getImportProfile", pykd::getImportProfile,
+        "Return time of the module registration phases at import as list of tuples (phase, seconds)" );
     python::def( "initialize", pykd::initialize,
         "Initialize local debug engine, only for console mode" );
     python::def( "remoteConnect",pykd::remote_initialize,
@@ -206,6 +418,9 @@ void pykd_init()
         "Get output mask");
     python::def("setOutputMask", pykd::setOutputMask,
         "Set output mask");
+    python::def("startOutputCapture", pykd::startOutputCaptureDeferred, startOutputCapture_( python::args("pattern", "isRegex", "capacity"),
+        "Start capturing debugger output lines containing pattern (or matching the regular expression) without calling Python. "
+        "Capturing lasts until the returned object is deleted" ) );
     python::def("getDumpType", pykd::getDumpType,
         "Return type of the dump");
     python::def("getDumpFormat", pykd::getDumpFormat,
@@ -219,6 +434,11 @@ void pykd_init()
         "command", "suppressOutput", "outputMask"), 
         "Run a debugger's command and return it's result as a string. You can set additional outputMask" \
         "if you want to get also error messages" ) );
+    python::def( "dbgCommandStream", &pykd::debugCommandStream, debugCommandStream_( python::args(
+        "command", "callback", "pattern", "isRegex", "batchSize"),
+        "Run a debugger's command passing its output lines containing pattern (or matching the regular expression) "
+        "to callback(lines) in batches while the command runs. The callback may return False to skip the rest "
+        "of the output. The output is not printed to the debugger console. Return the number of passed lines" ) );
     python::def( "go", pykd::targetGo,
         "Go debugging"  );
     python::def( "step", pykd::targetStep,
@@ -243,6 +463,17 @@ void pykd_init()
         "Provide input for debugger");
     python::def("setStatusMessage", &pykd::setStatusMessage,
         "Set message at a windbg status bar");
+    python::def("setProgress", &pykd::setProgress, setProgress_( python::args("done", "total", "text"),
+        "Show progress 'text: done/total (N%)' at a windbg status bar. The status bar is updated only when the percent "
+        "or the text changes. Raise KeyboardInterrupt if the script is cancelled" ) );
+    python::def("checkCancel", &pykd::checkCancel,
+        "Raise KeyboardInterrupt if the script is cancelled (CTRL+BREAK). Long native loops check it themselves" );
+    python::def("isCancelRequested", &pykd::isCancelRequested,
+        "Return True if the script is cancelled (CTRL+BREAK)" );
+    python::def("cancelScript", &pykd::requestCancel,
+        "Request cancellation: the next checkCancel or long native loop raises KeyboardInterrupt and clears the request" );
+    python::def("resetCancel", &pykd::resetCancel,
+        "Clear the cancellation request" );
 
 
     // Python debug output console helper classes
@@ -422,6 +653,10 @@ void pykd_init()
         "Load and return source file from source server by the specified offset") );
     python::def( "getSourceLine", pykd::getSourceLine, getSourceLine_( python::args( "offset"),
         "Return source file name, line and displacement by the specified offset" ) );
+    python::def( "getSourceLines", pykd::getSourceLines,
+        "Return list of (file name, line) for the list of offsets. Unresolved and zero offsets are None" );
+    python::def( "clearSourceLineCache", pykd::clearSourceLineCache,
+        "Drop line information cached by getSourceLine and getSourceLines" );
 
     python::def( "getOffset", pykd::getSymbolOffset,
         "Return target virtual address for specified symbol" );
@@ -465,6 +700,10 @@ void pykd_init()
         "Create typeInfo provider from pdb file") );
     python::def("getSymbolProviderFromSource", &pykd::getSymbolProviderFromSource, getSymbolProviderFromSource_(python::args("sourceCode", "compileOptions"),
         "Create symbol provider for source code"));
+    python::def("setSourceCacheSize", &pykd::setSourceCacheSize,
+        "Set maximum number of compiled sources kept by getTypeFromSource/getTypeInfoProviderFromSource/getSymbolProviderFromSource");
+    python::def("clearSourceCache", &pykd::clearSourceCache,
+        "Drop all cached results of the source code compilation");
     python::def("evalExpr", &pykd::evalExpr, evalExpr_(python::args("expression", "scope", "typeProvider"),
         "Evaluate C++ expression with typed information"));
 
@@ -478,6 +717,12 @@ void pykd_init()
         "Set a CPU register value by its name" );
     python::def( "setReg", pykd::setRegisterByIndex,
         "Set a CPU register value by its index" );
+    python::def( "getContextSnapshot", pykd::getContextSnapshot,
+        "Read all CPU registers at once and return a cpuContextSnapshot object" );
+    python::def( "setContext", pykd::setContext,
+        "Write all CPU registers from the cpuContextSnapshot object (sub-registers like al are not written separately)" );
+    python::def( "setContext", pykd::setContextFromDict,
+        "Write CPU registers from the dict ( name : value )" );
     python::def( "getNumberRegisters", pykd::getNumberRegisters,
         "Return a number of CPU registers");
     python::def( "getRegisterName", pykd::getRegisterName,
@@ -510,6 +755,17 @@ void pykd_init()
    // stack and local variables
     python::def( "getStack", pykd::getStack, getStack_(python::args("inlineFrames"),
         "Return a current stack as a list of stackFrame objects" ) );
+    python::def( "getStackTable", pykd::getStackTable, getStackTable_(python::args("inlineFrames"),
+        "Return a current stack as a stackTable object. Frame registers are read at once" ) );
+    python::def( "walkAllStacks", pykd::walkAllStacksDeferred, walkAllStacks_(python::args("filter"),
+        "Walk stacks of all threads of all processes and return a stackWalkResult object.\n"
+        "filter is an optional callable ( pid, tid ) -> bool" ) );
+    python::def( "aggregateStacks", pykd::aggregateStacksDeferred, aggregateStacks_(python::args("walkResult", "normalize"),
+        "Group identical stacks of the stackWalkResult and return a stackBuckets object.\n"
+        "If normalize is True frames are compared by module and offset instead of the address" ) );
+    python::def( "scanStack", pykd::scanStack, scanStack_(python::args("begin", "end", "callOnly"),
+        "Scan stack memory for pointers into loaded modules and return a list of tuples (stack offset, value, symbol).\n"
+        "If callOnly is True only values preceded by a call instruction are returned. The range is limited to 256 MB" ) );
     python::def( "getFrame", pykd::getCurrentFrame,
         "Return a current stack frame" );
     python::def("getFrameNumber", pykd::getCurrentFrameNumber,
@@ -539,9 +795,30 @@ void pykd_init()
 
     // breakpoints
     python::def( "setBp", &Breakpoint::setSoftwareBreakpoint,
-        setSoftwareBreakpoint_( python::args( "offset", "callback" ),"Set software breakpoint on execution" )[python::return_value_policy<python::manage_new_object>()]);
+        setSoftwareBreakpoint_( python::args( "offset", "callback", "condition" ),"Set software breakpoint on execution. "
+            "The condition is an expression over registers and memory evaluated without Python, the callback is called only if it is not zero. "
+            "Numbers are in the engine radix (hex by default), 0n, 0x, 0t and 0y prefixes select decimal, hex, octal and binary" )[python::return_value_policy<python::manage_new_object>()]);
     python::def( "setBp", &Breakpoint::setHardwareBreakpoint, 
-        setHardwareBreakpoint_( python::args( "offset", "size", "accsessType", "callback" ),"Set hardware breakpoint")[python::return_value_policy<python::manage_new_object>()]);
+        setHardwareBreakpoint_( python::args( "offset", "size", "accsessType", "callback", "condition" ),"Set hardware breakpoint")[python::return_value_policy<python::manage_new_object>()]);
+    python::def( "setBreakpoints", pykd::setBreakpoints, setBreakpoints_( python::args( "addresses", "callback" ),
+        "Set software breakpoints on all addresses, return list of their ids. The callback is shared by the breakpoints "
+        "and is called with the breakpoint id. Addresses which already have a registered breakpoint return its id" ) );
+    python::def( "removeBreakpoints", pykd::removeBreakpoints,
+        "Remove breakpoints set by setBreakpoints by their ids" );
+    python::def( "findBreakpoint", pykd::findBreakpoint,
+        "Return id of the breakpoint set by setBreakpoints on the address or None" );
+    python::def( "getRegisteredBreakpoints", pykd::getRegisteredBreakpoints,
+        "Return breakpoints set by setBreakpoints as list of tuples (id, offset)" );
+    python::def( "startCoverage", pykd::startCoverageDeferred,
+        "Set one-shot breakpoints on the addresses and collect hits without calling Python" );
+    python::def( "startFunctionCoverage", pykd::startFunctionCoverageDeferred,
+        "Set one-shot breakpoints on all functions of the module and collect hits without calling Python" );
+    python::def( "setCountingBp", pykd::setCountingBreakpointDeferred,
+        setCountingBreakpoint_( python::args( "offset", "sampleRate", "condition" ), "Set breakpoint which counts hits without calling Python. "
+            "If sampleRate is not zero, the caller of every sampleRate-th hit is recorded" )[python::return_value_policy<python::manage_new_object>()]);
+    python::def( "setTraceBp", pykd::setTraceBreakpointDeferred,
+        setTraceBreakpoint_( python::args( "offset", "spec", "capacity", "condition" ), "Set breakpoint which writes a record into a ring buffer on each hit without calling Python. "
+            "spec is a list of expressions (8 byte values) and (expression, size) tuples (memory at the address)" )[python::return_value_policy<python::manage_new_object>()]);
     python::def("getNumberBreakpoints", &Breakpoint::getNumberBreakpoints,
         "Return number of breakpoints in the current process" );
     python::def( "getBp", &Breakpoint::getBreakpointByIndex, python::return_value_policy<python::manage_new_object>(), 
@@ -637,6 +914,12 @@ void pykd_init()
         "Note: reloading the symbols for the module deletes all synthetic symbols associated with that module.");
     python::def( "removeSyntheticSymbol", pykd::removeSyntheticSymbol,
         "The removeSyntheticSymbol function removes a synthetic symbol from a module in the current process" );
+    python::def( "addSyntheticSymbols", pykd::addSyntheticSymbols,
+        "Add synthetic symbols from the list of (rva, size, name) relative to the base. Return number of added symbols" );
+    python::def( "loadSyntheticSymbols", pykd::loadSyntheticSymbols, loadSyntheticSymbols_( python::args( "fileName", "base" ),
+        "Add synthetic symbols from a perf map or MSVC linker map file. Return number of added symbols" ) );
+    python::def( "findSyntheticSymbol", pykd::findSyntheticSymbol,
+        "Return tuple (module name, symbol name, displacement) of the synthetic symbol containing the offset or None" );
 
     // synthetic module
     python::def("addSyntheticModule", pykd::addSyntheticModule, addSyntheticModule_(python::args("base", "size", "name", "path"),
@@ -650,6 +933,8 @@ void pykd_init()
     python::def("loadTaggedBuffer", pykd::loadTaggedBuffer,
         "Read the buffer of secondary callback data by ID" );
 
+    profiler.phase("target classes");
+
     python::class_<kdlib::NumConvertable, boost::noncopyable>( "numVariant", "numVariant", python::no_init )
         //.def("__init__", python::make_constructor(&NumVariantAdaptor::getVariant) )
         .def( "__eq__", &NumVariantAdaptor::eq )
@@ -737,6 +1022,8 @@ void pykd_init()
             "Return current process")
         .def("processes", TargetSystemAdapter::getProcessesList,
             "get list of processes for the target system")
+        .def("processTable", TargetSystemAdapter::getProcessTable,
+            "get list of dicts with process fields (id, systemID, peb, exeName) and threads as in targetProcess.threadTable")
         .def("__str__", TargetSystemAdapter::print)
         ;
 
@@ -785,6 +1072,8 @@ void pykd_init()
             "Return a module object by it's name" )
         .def("setCurrent", TargetProcessAdapter::setCurrent,
             "Set this process as a current")
+        .def("threadTable", TargetProcessAdapter::getThreadTable,
+            "get list of dicts with thread fields: id, systemID, teb, ip, sp, fp")
         .def("threads", TargetProcessAdapter::getThreadList,
             "Return list of threads for the target process")
         .def("breakpoints", TargetProcessAdapter::getBreakpointsList,
@@ -849,6 +1138,8 @@ void pykd_init()
             "Return heap's entries iterator object")[python::return_value_policy<python::manage_new_object>()] )
          ;
 
+    profiler.phase("module and type classes");
+
     python::class_<kdlib::Module, kdlib::ModulePtr, python::bases<kdlib::NumConvertable>, boost::noncopyable>("module", "Class representing executable module", python::no_init)
         .def("__init__", python::make_constructor(&ModuleAdapter::loadModuleByName))
         .def("__init__", python::make_constructor(&ModuleAdapter::loadModuleByOffset))
@@ -1155,6 +1446,44 @@ void pykd_init()
         .add_static_property( "Double", &BaseTypesEnum::getDouble )
         ;
 
+    profiler.phase("stack classes");
+
+    python::class_<FrameVarsList>( "frameVarsList",
+        "Sequence of (name, value) for frame's params or locals. Values are loaded on access", python::no_init )
+        .def( "__len__", &FrameVarsList::getCount )
+        .def( "__getitem__", &FrameVarsList::getItem )
+        .def( "__getitem__", &FrameVarsList::getSlice )
+        .def( "__iter__", &FrameVarsList::getIter )
+        .def( "__eq__", &FrameVarsList::equal )
+        .def( "__ne__", &FrameVarsList::notEqual )
+        .def( "__repr__", &FrameVarsList::repr )
+        .def( "__str__", &FrameVarsList::repr )
+        .def( "names", &FrameVarsList::getNames,
+            "Return list of names without loading values" )
+        .def( "values", &FrameVarsList::getValues,
+            "Return list of values" )
+        .def( "items", &FrameVarsList::getItems,
+            "Return list of tuples (name, value)" );
+
+    python::class_<FrameVarsDict>( "frameVarsDict",
+        "Mapping name : value for frame's params or locals. Values are loaded on access", python::no_init )
+        .def( "__len__", &FrameVarsDict::getCount )
+        .def( "__getitem__", &FrameVarsDict::getItem )
+        .def( "__contains__", &FrameVarsDict::contains )
+        .def( "__iter__", &FrameVarsDict::getIter )
+        .def( "__eq__", &FrameVarsDict::equal )
+        .def( "__ne__", &FrameVarsDict::notEqual )
+        .def( "__repr__", &FrameVarsDict::repr )
+        .def( "__str__", &FrameVarsDict::repr )
+        .def( "get", &FrameVarsDict::get, FrameVarsDict_get( python::args("name", "default"),
+            "Return value by name or default if there is no such name" ) )
+        .def( "keys", &FrameVarsDict::getNames,
+            "Return list of names without loading values" )
+        .def( "values", &FrameVarsDict::getValues,
+            "Return list of values" )
+        .def( "items", &FrameVarsDict::getItems,
+            "Return list of tuples (name, value)" );
+
     python::class_<kdlib::StackFrame, kdlib::StackFramePtr, boost::noncopyable>( "stackFrame",
         "class for stack's frame representation", python::no_init  )
         .add_property( "ip", StackFrameAdapter::getIP, 
@@ -1195,6 +1524,45 @@ void pykd_init()
             "return source line for stack frame's function" )
         .def( "__str__", StackFrameAdapter::print );
 
+    python::class_<StackTable, StackTablePtr, boost::noncopyable>( "stackTable",
+        "class for stack representation with frame registers captured at the stack walk", python::no_init )
+        .def( "__len__", &StackTable::getFrameCount )
+        .def( "__getitem__", &StackTable::getFrame,
+            "Return stackFrame object by index" )
+        .def( "getIP", &StackTable::getIP,
+            "Return instruction pointer of the frame by index" )
+        .def( "getRET", &StackTable::getRET,
+            "Return return pointer of the frame by index" )
+        .def( "getSP", &StackTable::getSP,
+            "Return stack pointer of the frame by index" )
+        .def( "getFP", &StackTable::getFP,
+            "Return frame pointer of the frame by index" )
+        .add_property( "ips", &StackTable::getIPs,
+            "Return instruction pointers of all frames as a list" )
+        .add_property( "rets", &StackTable::getRETs,
+            "Return return pointers of all frames as a list" )
+        .add_property( "sps", &StackTable::getSPs,
+            "Return stack pointers of all frames as a list" )
+        .add_property( "fps", &StackTable::getFPs,
+            "Return frame pointers of all frames as a list" )
+        .def( "getTable", &StackTable::getTable,
+            "Return list of tuples (ip, ret, sp, fp) for all frames" )
+        .def( "__str__", &StackTable::print );
+
+    python::class_<CPUContextSnapshot, CPUContextSnapshotPtr, boost::noncopyable>( "cpuContextSnapshot",
+        "All CPU registers read at once. Index it by register name or position to get a value", python::no_init )
+        .def( "__len__", &CPUContextSnapshot::getCount )
+        .def( "__getitem__", &CPUContextSnapshot::getItemByIndex )
+        .def( "__getitem__", &CPUContextSnapshot::getValueByName )
+        .def( "__getattr__", &CPUContextSnapshot::getAttr )
+        .def( "__contains__", &CPUContextSnapshot::contains )
+        .def( "keys", &CPUContextSnapshot::getNames,
+            "Return list of register names" )
+        .def( "items", &CPUContextSnapshot::getItems,
+            "Return list of tuples (name, value)" );
+
+    profiler.phase("context and system classes");
+
     python::class_<CPUContextAdapter>("cpu", "class for CPU context representation" )
          //.def("__init__", python::make_constructor(CPUContextAdapter::getCPUContext) )
          .add_property("ip", &CPUContextAdapter::getIP )
@@ -1373,6 +1741,8 @@ void pykd_init()
         .def("__iter__", SymbolProviderAdapter::getIter, python::return_value_policy<python::manage_new_object>())
         ;
 
+    profiler.phase("enums");
+
     python::enum_<kdlib::DebugCallbackResult>("eventResult", "Return value of event handler")
         .value("Proceed", kdlib::DebugCallbackProceed)
         .value("NoChange", kdlib::DebugCallbackNoChange)
@@ -1456,6 +1826,8 @@ void pykd_init()
         .value("Default", kdlib::ProcessDebugDefault)
         ;
 
+    profiler.phase("event classes");
+
     python::class_<EventHandler, boost::noncopyable>(
         "eventHandler", "Base class for overriding and handling debug notifications" )
          .def( "onBreakpoint", &EventHandler::onBreakpoint,
@@ -1494,6 +1866,15 @@ void pykd_init()
             "New thread is started in the current process" )
         .def("onThreadStop", &EventHandler::onThreadStop,
             "A thread is stopped in the current thread")
+        .def("setQueuedMode", &EventHandler::setQueuedMode, EventHandler_setQueuedMode( python::args("queued", "batchSize", "capacity"),
+            "Queue notification events natively and deliver them in batches: to onEvents(list of tuples (handlerName, args...)) "
+            "if it is defined, else to the separate handlers. Batches are delivered on flushEvents, when the target stops "
+            "and when batchSize events are queued (if batchSize is not zero). At most capacity events are queued, "
+            "the oldest ones are dropped" ) )
+        .def("flushEvents", &EventHandler::flushEvents,
+            "Deliver queued events now")
+        .def("getDroppedEvents", &EventHandler::getDroppedEvents,
+            "Return number of queued events dropped because the queue was full")
 
    //     .def( "onSymbolsLoaded", &EventHandlerWrap::onSymbolsLoaded,
    //         "Triggered debug symbols loaded. Parameter - module base or 0\n"
@@ -1516,8 +1897,16 @@ void pykd_init()
             "Breakpoint hit callback")
         .def("detach", &Breakpoint::detach, python::return_value_policy<python::manage_new_object>(),
             "detach breakpoint")
+        .def("setCondition", &Breakpoint::setCondition,
+            "Set condition evaluated without Python on each hit: onHit is called only if it is not zero. "
+            "Syntax: numbers in the engine radix (hex by default) or with 0n/0x/0t/0y prefix, ` digit separators, "
+            "registers (rcx, @rcx), module!symbol, poi/by/wo/dwo/qwo(addr), C operators")
+        .def("getCondition", &Breakpoint::getCondition,
+            "Return breakpoint condition")
         ;
 
+    profiler.phase("synthetic symbols and options");
+
     python::class_<kdlib::SyntheticSymbol>(
         "syntheticSymbol", "Structure describes a synthetic symbol within a module", python::no_init)
         .def_readonly( "moduleBase", &kdlib::SyntheticSymbol::moduleBase,
@@ -1592,8 +1981,138 @@ void pykd_init()
         .value("UserSmallIgnoreInaccessibleMem", kdlib::UserSmallIgnoreInaccessibleMem)
         ;
 
+    profiler.phase("exceptions");
+
     // C++ exception translation to python
     pykd::registerExceptions();
+
+    profiler.finish();
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+
+void pykd::registerStackWalkClasses()
+{
+    python::class_<StackWalkResult, StackWalkResultPtr, boost::noncopyable>( "stackWalkResult",
+        "Stacks of all threads in columns. Thread columns: pids, tids, stackStarts, stackSizes, failed.\n"
+        "Frame columns: ips, rets, sps, fps, symbolIds ( index in symbols )", python::no_init )
+        .add_property( "threadCount", &StackWalkResult::getThreadCount )
+        .add_property( "frameCount", &StackWalkResult::getFrameCount )
+        .add_property( "pids", &StackWalkResult::getPids )
+        .add_property( "tids", &StackWalkResult::getTids )
+        .add_property( "stackStarts", &StackWalkResult::getStackStarts )
+        .add_property( "stackSizes", &StackWalkResult::getStackSizes )
+        .add_property( "failed", &StackWalkResult::getFailed )
+        .add_property( "ips", &StackWalkResult::getIPs )
+        .add_property( "rets", &StackWalkResult::getRETs )
+        .add_property( "sps", &StackWalkResult::getSPs )
+        .add_property( "fps", &StackWalkResult::getFPs )
+        .add_property( "symbolIds", &StackWalkResult::getSymbolIds )
+        .add_property( "symbols", &StackWalkResult::getSymbols )
+        .add_property( "modules", &StackWalkResult::getModules )
+        .def( "getStack", &StackWalkResult::getStack,
+            "Return stack of the thread by index as a list of tuples (ip, symbol)" )
+        .def( "__str__", &StackWalkResult::print );
+
+    python::class_<StackBuckets, StackBucketsPtr, boost::noncopyable>( "stackBuckets",
+        "Groups of identical stacks sorted by the thread count", python::no_init )
+        .def( "__len__", &StackBuckets::getBucketCount )
+        .def( "getCount", &StackBuckets::getCount,
+            "Return number of threads in the bucket" )
+        .def( "getThreads", &StackBuckets::getThreads,
+            "Return threads of the bucket as a list of tuples (pid, tid)" )
+        .def( "getStack", &StackBuckets::getStack,
+            "Return stack of the bucket as a list of symbols, the innermost frame first" )
+        .def( "getCallTree", &StackBuckets::getCallTree,
+            "Return merged call tree as nested tuples (function, count, [children]), the root is unnamed" )
+        .def( "folded", &StackBuckets::getFolded,
+            "Return stacks in the folded format for flame graphs: 'outer;...;inner count' per line" )
+        .def( "__str__", &StackBuckets::print );
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+
+void pykd::registerProbeClasses()
+{
+    python::class_<CountingBreakpoint, boost::noncopyable>( "countingBreakpoint",
+        "Breakpoint collecting hit statistics without calling Python", python::no_init )
+        .def("getId", &CountingBreakpoint::getId,
+            "Return breakpoint ID" )
+        .def("getOffset", &CountingBreakpoint::getOffset,
+            "Return breakpoint's memory offset")
+        .def("remove", &CountingBreakpoint::remove,
+            "Remove breakpoint" )
+        .def("getSampleRate", &CountingBreakpoint::getSampleRate,
+            "Return caller sampling rate, zero if callers are not recorded")
+        .def("getHitCount", &CountingBreakpoint::getHitCount,
+            "Return number of hits")
+        .def("getThreadCounts", &CountingBreakpoint::getThreadCounts,
+            "Return dict: thread system id -> number of hits")
+        .def("getCallers", &CountingBreakpoint::getCallers,
+            "Return sampled callers as list of tuples (return address, count, symbol), the most frequent first")
+        .def("reset", &CountingBreakpoint::reset,
+            "Reset statistics")
+        .def("__str__", &CountingBreakpoint::print,
+            "Return statistics as a string")
+        ;
+
+    python::class_<TraceBreakpoint, boost::noncopyable>( "traceBreakpoint",
+        "Breakpoint recording fixed size records into a ring buffer without calling Python", python::no_init )
+        .def("getId", &TraceBreakpoint::getId,
+            "Return breakpoint ID" )
+        .def("getOffset", &TraceBreakpoint::getOffset,
+            "Return breakpoint's memory offset")
+        .def("remove", &TraceBreakpoint::remove,
+            "Remove breakpoint" )
+        .def("getRecordSize", &TraceBreakpoint::getRecordSize,
+            "Return size of a record in bytes")
+        .def("getCapacity", &TraceBreakpoint::getCapacity,
+            "Return number of records the ring buffer holds")
+        .def("getLayout", &TraceBreakpoint::getLayout,
+            "Return record layout as list of tuples (name, offset, size)")
+        .def("getHitCount", &TraceBreakpoint::getHitCount,
+            "Return number of recorded hits, including overwritten ones")
+        .def("getRecordCount", &TraceBreakpoint::getRecordCount,
+            "Return number of records in the buffer")
+        .def("getRecords", &TraceBreakpoint::getRecords,
+            "Return records as bytearray, the oldest first")
+        .def("reset", &TraceBreakpoint::reset,
+            "Discard recorded records")
+        ;
+
+    python::class_<CodeCoverage, CodeCoveragePtr, boost::noncopyable>( "codeCoverage",
+        "Code coverage collected with one-shot breakpoints", python::no_init )
+        .def("getAddressCount", &CodeCoverage::getAddressCount,
+            "Return number of covered addresses")
+        .def("getAddresses", &CodeCoverage::getAddresses,
+            "Return sorted list of covered addresses, bitmap bits follow this order")
+        .def("getHitCount", &CodeCoverage::getHitCount,
+            "Return number of hit addresses")
+        .def("getHits", &CodeCoverage::getHits,
+            "Return list of hit addresses")
+        .def("getMissed", &CodeCoverage::getMissed,
+            "Return list of addresses not hit yet")
+        .def("getBitmap", &CodeCoverage::getBitmap,
+            "Return bytearray: bit N (byte N/8, bit N%8) is set if the N-th address is hit")
+        .def("getHitOrder", &CodeCoverage::getHitOrder,
+            "Return bytearray of 32 bit address indices in the hit order")
+        .def("stop", &CodeCoverage::stop,
+            "Remove breakpoints not hit yet")
+        ;
+
+    python::class_<OutputCapture, OutputCapturePtr, boost::noncopyable>( "outputCapture",
+        "Captured debugger output", python::no_init )
+        .def("read", &OutputCapture::read, OutputCapture_read( python::args("maxCount"),
+            "Remove and return captured lines as list of tuples (timestamp, outputFlag, text), the oldest first. "
+            "Zero maxCount returns all lines. An unterminated last line is returned too, its rest comes as a separate line" ) )
+        .def("getCount", &OutputCapture::getCount,
+            "Return number of captured lines not read yet")
+        .def("getDropped", &OutputCapture::getDropped,
+            "Return number of lines dropped because the buffer was full")
+        .def("clear", &OutputCapture::clear,
+            "Discard captured lines")
+        .def("__len__", &OutputCapture::getCount )
+        ;
 }
 
 //////////////////////////////////////////////////////////////////////////////////
@@ -1,6 +1,7 @@
 #include "stdafx.h"
 
 #include "pymodule.h"
+#include "pycancel.h"
 #include <iomanip>
 #include <ctime>
 
@@ -70,7 +71,10 @@ python::list ModuleAdapter::enumSymbols( kdlib::Module& module, const std::wstri
 
     python::list  pyLst;
     for (  kdlib::SymbolOffsetList::const_iterator it = offsetLst.begin(); it != offsetLst.end(); ++it )
+    {
+        checkCancel();
         pyLst.append( python::make_tuple( it->first, it->second ) );
+    }
     return pyLst;
 }
 
@@ -151,7 +155,7 @@ python::list ModuleAdapter::getTypedVarListByTypeName( kdlib::Module& module, kd
         lst = module.loadTypedVarList( offset, typeName, fieldName );
     } while(false);
 
-    return vectorToList( lst );
+    return typedVarListToList( lst );
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -165,7 +169,7 @@ python::list ModuleAdapter::getTypedVarArrayByTypeName( kdlib::Module& module, k
         lst =  module.loadTypedVarArray( offset, typeName, number );
     } while(false);
 
-    return vectorToList( lst );
+    return typedVarListToList( lst );
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,412 @@
+#include "stdafx.h"
+
+#include <chrono>
+
+#include <dbgeng.h>
+
+#include <boost/python/tuple.hpp>
+
+#include "kdlib/exceptions.h"
+
+#include "pyoutputcapture.h"
+#include "pydbgio.h"
+
+namespace pykd {
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+double getTimestamp()
+{
+    return std::chrono::duration<double>( std::chrono::system_clock::now().time_since_epoch() ).count();
+}
+
+} // anonymous namespace
+
+///////////////////////////////////////////////////////////////////////////////
+
+OutputLineFilter::OutputLineFilter( const std::wstring& pattern, bool isRegex ) :
+    m_pattern( pattern ),
+    m_isRegex( isRegex ),
+    m_partialFlag( kdlib::Normal )
+{
+    if ( isRegex )
+    {
+        try {
+            m_regex.assign( pattern, std::regex_constants::ECMAScript | std::regex_constants::optimize );
+        }
+        catch ( const std::regex_error& err )
+        {
+            throw kdlib::DbgException( std::string("Invalid regular expression: ") + err.what() );
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void OutputLineFilter::addOutput( const std::wstring& text, kdlib::OutputFlag flag )
+{
+    if ( !m_partial.empty() && m_partialFlag != flag )
+        flushPartial();
+
+    size_t  begin = 0;
+
+    while ( true )
+    {
+        size_t  end = text.find( L'\n', begin );
+        if ( end == std::wstring::npos )
+            break;
+
+        m_partial.append( text, begin, end - begin );
+        if ( !m_partial.empty() && m_partial[m_partial.size() - 1] == L'\r' )
+            m_partial.erase( m_partial.size() - 1 );
+
+        addLine( m_partial, flag );
+        m_partial.clear();
+
+        begin = end + 1;
+    }
+
+    m_partial.append( text, begin, std::wstring::npos );
+    m_partialFlag = flag;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void OutputLineFilter::flushPartial()
+{
+    if ( m_partial.empty() )
+        return;
+
+    addLine( m_partial, m_partialFlag );
+    m_partial.clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool OutputLineFilter::isMatched( const std::wstring& line ) const
+{
+    if ( m_isRegex )
+        return std::regex_search( line, m_regex );
+
+    return m_pattern.empty() || line.find( m_pattern ) != std::wstring::npos;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void OutputLineFilter::addLine( const std::wstring& text, kdlib::OutputFlag flag )
+{
+    if ( isMatched( text ) )
+        onLine( text, flag );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+OutputCapture::OutputCapture( const std::wstring& pattern, bool isRegex, size_t capacity ) :
+    OutputLineFilter( pattern, isRegex ),
+    m_capacity( capacity ),
+    m_dropped( 0 )
+{
+    if ( capacity == 0 )
+        throw kdlib::DbgException("Output capture capacity must not be zero");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void OutputCapture::onDebugOutput( const std::wstring& text, kdlib::OutputFlag flag )
+{
+    boost::mutex::scoped_lock  lock(m_lock);
+    addOutput( text, flag );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void OutputCapture::onLine( const std::wstring& text, kdlib::OutputFlag flag )
+{
+    if ( m_lines.size() == m_capacity )
+    {
+        m_lines.pop_front();
+        ++m_dropped;
+    }
+
+    Line  line = { getTimestamp(), flag, text };
+    m_lines.push_back( line );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::list OutputCapture::read( size_t maxCount )
+{
+    std::deque<Line>  lines;
+
+    do {
+
+        AutoRestorePyState  pystate;
+        boost::mutex::scoped_lock  lock(m_lock);
+
+        // the output printed so far is readable even without the line end
+        flushPartial();
+
+        if ( maxCount == 0 || maxCount >= m_lines.size() )
+        {
+            lines.swap( m_lines );
+            break;
+        }
+
+        lines.assign( m_lines.begin(), m_lines.begin() + maxCount );
+        m_lines.erase( m_lines.begin(), m_lines.begin() + maxCount );
+
+    } while(false);
+
+    python::list  lst;
+    for ( std::deque<Line>::const_iterator it = lines.begin(); it != lines.end(); ++it )
+        lst.append( python::make_tuple( it->timestamp, it->flag, it->text ) );
+
+    return lst;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+size_t OutputCapture::getCount()
+{
+    AutoRestorePyState  pystate;
+    boost::mutex::scoped_lock  lock(m_lock);
+    return m_lines.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+unsigned long long OutputCapture::getDropped()
+{
+    AutoRestorePyState  pystate;
+    boost::mutex::scoped_lock  lock(m_lock);
+    return m_dropped;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void OutputCapture::clear()
+{
+    AutoRestorePyState  pystate;
+    boost::mutex::scoped_lock  lock(m_lock);
+    m_lines.clear();
+    resetPartial();
+    m_dropped = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+OutputCapturePtr startOutputCapture( const std::wstring& pattern, bool isRegex, size_t capacity )
+{
+    AutoRestorePyState  pystate;
+    return OutputCapturePtr( new OutputCapture( pattern, isRegex, capacity ) );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+class CommandOutputStream : public OutputLineFilter
+{
+public:
+
+    CommandOutputStream( const python::object& callback, const std::wstring& pattern, bool isRegex, size_t batchSize, PyThreadState** pystate ) :
+        OutputLineFilter( pattern, isRegex ),
+        m_callback( callback ),
+        m_batchSize( batchSize ),
+        m_pystate( pystate ),
+        m_lineCount( 0 ),
+        m_stopped( false ),
+        m_errType( 0 ),
+        m_errValue( 0 ),
+        m_errTraceback( 0 )
+    {}
+
+    void finish()
+    {
+        flushPartial();
+        deliver();
+    }
+
+    size_t getLineCount() const {
+        return m_lineCount;
+    }
+
+    // the python error is kept while the GIL is released, restored after the command
+    bool restoreError()
+    {
+        if ( !m_errType )
+            return false;
+
+        PyErr_Restore( m_errType, m_errValue, m_errTraceback );
+        return true;
+    }
+
+protected:
+
+    void onLine( const std::wstring& text, kdlib::OutputFlag flag ) override
+    {
+        if ( m_stopped )
+            return;
+
+        m_batch.push_back( text );
+
+        if ( m_batch.size() >= m_batchSize )
+            deliver();
+    }
+
+private:
+
+    void deliver()
+    {
+        if ( m_batch.empty() || m_stopped )
+            return;
+
+        std::vector<std::wstring>  batch;
+        batch.swap( m_batch );
+
+        AutoSavePythonState  savePyState( m_pystate );
+
+        try {
+
+            python::list  lines;
+            for ( size_t i = 0; i < batch.size(); ++i )
+                lines.append( batch[i] );
+
+            python::object  resObj = m_callback( lines );
+
+            m_lineCount += batch.size();
+
+            if ( PyBool_Check( resObj.ptr() ) && !python::extract<bool>( resObj ) )
+                m_stopped = true;
+        }
+        catch (const python::error_already_set&)
+        {
+            PyErr_Fetch( &m_errType, &m_errValue, &m_errTraceback );
+            m_stopped = true;
+        }
+    }
+
+    python::object  m_callback;
+    size_t  m_batchSize;
+    PyThreadState**  m_pystate;
+
+    std::vector<std::wstring>  m_batch;
+    size_t  m_lineCount;
+    bool  m_stopped;
+
+    PyObject*  m_errType;
+    PyObject*  m_errValue;
+    PyObject*  m_errTraceback;
+};
+
+// The command output goes only to a private client, so the lines reach the
+// stream while the engine prints them: nothing is collected or echoed back
+class CommandOutputCallbacks : public IDebugOutputCallbacksWide
+{
+public:
+
+    explicit CommandOutputCallbacks( OutputLineFilter& filter ) :
+        m_filter( filter )
+    {}
+
+    STDMETHOD(QueryInterface)( REFIID interfaceId, PVOID* iface )
+    {
+        if ( IsEqualIID( interfaceId, __uuidof(IUnknown) ) || IsEqualIID( interfaceId, __uuidof(IDebugOutputCallbacksWide) ) )
+        {
+            *iface = this;
+            return S_OK;
+        }
+
+        *iface = 0;
+        return E_NOINTERFACE;
+    }
+
+    STDMETHOD_(ULONG, AddRef)() {
+        return 1;
+    }
+
+    STDMETHOD_(ULONG, Release)() {
+        return 1;
+    }
+
+    STDMETHOD(Output)( ULONG mask, PCWSTR text )
+    {
+        try {
+            m_filter.addOutput( text, static_cast<kdlib::OutputFlag>( mask ) );
+        }
+        catch (...)
+        {}
+
+        return S_OK;
+    }
+
+private:
+
+    OutputLineFilter&  m_filter;
+};
+
+void executeCommand( const std::wstring& command, OutputLineFilter& filter )
+{
+    IDebugClient5*  client = 0;
+
+    HRESULT  hres = DebugCreate( __uuidof(IDebugClient5), reinterpret_cast<void**>( &client ) );
+    if ( FAILED( hres ) )
+        throw kdlib::DbgException( "failed to create debug client" );
+
+    IDebugControl4*  control = 0;
+
+    hres = client->QueryInterface( __uuidof(IDebugControl4), reinterpret_cast<void**>( &control ) );
+    if ( FAILED( hres ) )
+    {
+        client->Release();
+        throw kdlib::DbgException( "failed to query debug control" );
+    }
+
+    CommandOutputCallbacks  callbacks( filter );
+
+    client->SetOutputCallbacksWide( &callbacks );
+
+    hres = control->ExecuteWide( DEBUG_OUTCTL_THIS_CLIENT, command.c_str(), DEBUG_EXECUTE_NOT_LOGGED );
+
+    client->SetOutputCallbacksWide( 0 );
+
+    control->Release();
+    client->Release();
+
+    if ( FAILED( hres ) )
+        throw kdlib::DbgException( "failed to execute command" );
+}
+
+} // anonymous namespace
+
+///////////////////////////////////////////////////////////////////////////////
+
+size_t debugCommandStream( const std::wstring& command, const python::object& callback,
+    const std::wstring& pattern, bool isRegex, size_t batchSize )
+{
+    PyThreadState*  pystate;
+
+    // the callback reference is taken with the GIL held
+    CommandOutputStream  stream( callback, pattern, isRegex, batchSize != 0 ? batchSize : 1, &pystate );
+
+    do {
+
+        FlushedEngineCall  engineCall( &pystate );
+
+        executeCommand( command, stream );
+
+        stream.finish();
+
+    } while(false);
+
+    if ( stream.restoreError() )
+        throw python::error_already_set();
+
+    return stream.getLineCount();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+} // end namespace pykd
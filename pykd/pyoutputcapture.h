@@ -0,0 +1,125 @@
+#pragma once
+
+#include <deque>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/python/list.hpp>
+namespace python = boost::python;
+
+#include "kdlib/dbgengine.h"
+#include "kdlib/eventhandler.h"
+
+#include "pythreadstate.h"
+
+namespace pykd {
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Splits debugger output chunks into lines and passes the lines matching
+// a substring or a regular expression (compiled once) to onLine. It is not
+// an event handler itself: the owner decides where the output comes from
+
+class OutputLineFilter : private boost::noncopyable
+{
+
+public:
+
+    OutputLineFilter( const std::wstring& pattern, bool isRegex );
+
+    virtual ~OutputLineFilter() {}
+
+    void addOutput( const std::wstring& text, kdlib::OutputFlag flag );
+
+protected:
+
+    virtual void onLine( const std::wstring& text, kdlib::OutputFlag flag ) = 0;
+
+    // pass the unterminated last line
+    void flushPartial();
+
+    void resetPartial() {
+        m_partial.clear();
+    }
+
+private:
+
+    bool isMatched( const std::wstring& line ) const;
+
+    void addLine( const std::wstring& text, kdlib::OutputFlag flag );
+
+    std::wstring  m_pattern;
+    bool  m_isRegex;
+    std::wregex  m_regex;
+
+    // an output chunk may end in the middle of a line
+    std::wstring  m_partial;
+    kdlib::OutputFlag  m_partialFlag;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Collects debugger output lines without calling Python. The matching lines
+// are kept with their timestamp and output flag in a bounded buffer; the
+// oldest lines are dropped when it is full. An unterminated last line is
+// added by read, so its rest comes as a separate line. Capturing lasts until
+// the object is deleted
+
+class OutputCapture : public OutputLineFilter, public kdlib::EventHandler
+{
+
+public:
+
+    OutputCapture( const std::wstring& pattern, bool isRegex, size_t capacity );
+
+    void onDebugOutput( const std::wstring& text, kdlib::OutputFlag flag ) override;
+
+    python::list read( size_t maxCount = 0 );
+
+    size_t getCount();
+
+    unsigned long long getDropped();
+
+    void clear();
+
+protected:
+
+    void onLine( const std::wstring& text, kdlib::OutputFlag flag ) override;
+
+private:
+
+    struct Line {
+        double  timestamp;
+        kdlib::OutputFlag  flag;
+        std::wstring  text;
+    };
+
+    size_t  m_capacity;
+
+    boost::mutex  m_lock;
+
+    std::deque<Line>  m_lines;
+    unsigned long long  m_dropped;
+};
+
+typedef boost::shared_ptr<OutputCapture>  OutputCapturePtr;
+
+OutputCapturePtr startOutputCapture( const std::wstring& pattern = L"", bool isRegex = false, size_t capacity = 0x10000 );
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Runs a debugger command and passes its output lines to callback(lines) in
+// batches while the engine produces them, so the whole output is never held
+// in memory. The callback may return False to skip the rest of the output.
+// Returns the number of passed lines
+
+size_t debugCommandStream( const std::wstring& command, const python::object& callback,
+    const std::wstring& pattern = L"", bool isRegex = false, size_t batchSize = 0x100 );
+
+///////////////////////////////////////////////////////////////////////////////
+
+} // end namespace pykd
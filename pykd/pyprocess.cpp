@@ -1,6 +1,7 @@
 #include "stdafx.h"
 
 #include "pyprocess.h"
+#include "pycancel.h"
 #include "stladaptor.h"
 
 namespace pykd {
@@ -79,6 +80,155 @@ python::list TargetProcessAdapter::getModulesList(kdlib::TargetProcess& process)
 
 ///////////////////////////////////////////////////////////////////////////////
 
+namespace {
+
+// Process and thread fields read in one pass without the GIL.
+// Fields that the target can not provide are converted to None
+
+template<typename T>
+struct OptionalField {
+
+    OptionalField() : valid(false), value() {}
+
+    python::object toPython() const {
+        return valid ? python::object(value) : python::object();
+    }
+
+    bool  valid;
+    T  value;
+};
+
+template<typename T, typename TRead>
+void readField( OptionalField<T>& field, TRead read )
+{
+    try {
+        field.value = read();
+        field.valid = true;
+    }
+    catch( kdlib::DbgException& )
+    {}
+}
+
+struct ThreadRow {
+    OptionalField<kdlib::THREAD_DEBUG_ID>  id;
+    OptionalField<kdlib::THREAD_ID>  systemId;
+    OptionalField<kdlib::MEMOFFSET_64>  teb;
+    OptionalField<kdlib::MEMOFFSET_64>  ip;
+    OptionalField<kdlib::MEMOFFSET_64>  sp;
+    OptionalField<kdlib::MEMOFFSET_64>  fp;
+};
+
+struct ProcessRow {
+    OptionalField<kdlib::PROCESS_DEBUG_ID>  id;
+    OptionalField<kdlib::PROCESS_ID>  systemId;
+    OptionalField<kdlib::MEMOFFSET_64>  peb;
+    OptionalField<std::wstring>  exeName;
+    std::vector<ThreadRow>  threads;
+};
+
+void readThreads( kdlib::TargetProcess& process, std::vector<ThreadRow>& rows )
+{
+    unsigned long  threadCount = process.getNumberThreads();
+    rows.resize(threadCount);
+
+    for ( unsigned long i = 0; i < threadCount; ++i )
+    {
+        checkCancel();
+
+        kdlib::TargetThreadPtr  thread = process.getThreadByIndex(i);
+        ThreadRow&  row = rows[i];
+
+        readField( row.id, [&]() { return thread->getId(); } );
+        readField( row.systemId, [&]() { return thread->getSystemId(); } );
+        readField( row.teb, [&]() { return thread->getTebOffset(); } );
+        readField( row.ip, [&]() { return thread->getInstructionOffset(); } );
+        readField( row.sp, [&]() { return thread->getStackOffset(); } );
+        readField( row.fp, [&]() { return thread->getFrameOffset(); } );
+    }
+}
+
+python::list threadsToPython( const std::vector<ThreadRow>& rows )
+{
+    python::list  lst;
+
+    for ( size_t i = 0; i < rows.size(); ++i )
+    {
+        python::dict  dict;
+        dict["id"] = rows[i].id.toPython();
+        dict["systemID"] = rows[i].systemId.toPython();
+        dict["teb"] = rows[i].teb.toPython();
+        dict["ip"] = rows[i].ip.toPython();
+        dict["sp"] = rows[i].sp.toPython();
+        dict["fp"] = rows[i].fp.toPython();
+        lst.append(dict);
+    }
+
+    return lst;
+}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::list TargetSystemAdapter::getProcessTable(kdlib::TargetSystem& system)
+{
+    std::vector<ProcessRow>  processRows;
+
+    do {
+        AutoRestorePyState  pystate;
+
+        unsigned long  processCount = system.getNumberProcesses();
+        processRows.resize(processCount);
+
+        for ( unsigned long i = 0; i < processCount; ++i )
+        {
+            checkCancel();
+
+            kdlib::TargetProcessPtr  process = system.getProcessByIndex(i);
+            ProcessRow&  row = processRows[i];
+
+            readField( row.id, [&]() { return process->getId(); } );
+            readField( row.systemId, [&]() { return process->getSystemId(); } );
+            readField( row.peb, [&]() { return process->getPebOffset(); } );
+            readField( row.exeName, [&]() { return process->getExecutableName(); } );
+
+            readThreads( *process, row.threads );
+        }
+
+    } while(false);
+
+    python::list  lst;
+
+    for ( size_t i = 0; i < processRows.size(); ++i )
+    {
+        python::dict  dict;
+        dict["id"] = processRows[i].id.toPython();
+        dict["systemID"] = processRows[i].systemId.toPython();
+        dict["peb"] = processRows[i].peb.toPython();
+        dict["exeName"] = processRows[i].exeName.toPython();
+        dict["threads"] = threadsToPython( processRows[i].threads );
+        lst.append(dict);
+    }
+
+    return lst;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::list TargetProcessAdapter::getThreadTable(kdlib::TargetProcess& process)
+{
+    std::vector<ThreadRow>  threadRows;
+
+    do {
+        AutoRestorePyState  pystate;
+        readThreads( process, threadRows );
+    } while(false);
+
+    return threadsToPython(threadRows);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 std::wstring TargetProcessAdapter::print(kdlib::TargetProcess& process)
 {
     std::wstringstream sstr;
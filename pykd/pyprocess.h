@@ -108,6 +108,8 @@ struct TargetSystemAdapter {
 
     static python::list getProcessesList(kdlib::TargetSystem& system);
 
+    static python::list getProcessTable(kdlib::TargetSystem& system);
+
     static std::wstring print(kdlib::TargetSystem& system);
 };
 
@@ -266,6 +268,8 @@ struct TargetProcessAdapter {
 
     static python::list getThreadList(kdlib::TargetProcess& process);
 
+    static python::list getThreadTable(kdlib::TargetProcess& process);
+
     static python::list getBreakpointsList(kdlib::TargetProcess& process);
 
     static python::list getModulesList(kdlib::TargetProcess& process);
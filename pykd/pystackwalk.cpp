@@ -0,0 +1,907 @@
+#include "stdafx.h"
+
+#include <algorithm>
+#include <map>
+#include <unordered_map>
+
+#include <boost/functional/hash.hpp>
+
+#include "kdlib/memaccess.h"
+#include "kdlib/module.h"
+#include "kdlib/stack.h"
+
+#include "pystackwalk.h"
+#include "pytypeinfo.h"
+#include "pycancel.h"
+
+namespace pykd {
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+// Symbolization shared by all stacks of the walk. Symbol and module names are
+// interned in the result tables, the resolved offsets are cached per process
+// because user mode addresses of different processes are not related
+
+class StackSymbolizer {
+
+public:
+
+    explicit StackSymbolizer( StackWalkResult& result ) :
+        m_result( result )
+    {}
+
+    void setProcess()
+    {
+        m_offsets.clear();
+        m_moduleRanges.clear();
+    }
+
+    void symbolize( StackWalkResult::FrameRow& frame )
+    {
+        std::unordered_map<kdlib::MEMOFFSET_64, StackWalkResult::FrameRow>::iterator  it = m_offsets.find(frame.ip);
+        if ( it == m_offsets.end() )
+        {
+            StackWalkResult::FrameRow  symbol = {};
+
+            symbol.symbolId = internSymbol( formatSymbol(frame.ip) );
+
+            kdlib::MEMOFFSET_64  moduleBase;
+            symbol.moduleId = findModule( frame.ip, moduleBase );
+            symbol.moduleOffset = symbol.moduleId != StackWalkResult::noModule ? frame.ip - moduleBase : frame.ip;
+
+            it = m_offsets.insert( std::make_pair( frame.ip, symbol ) ).first;
+        }
+
+        frame.symbolId = it->second.symbolId;
+        frame.moduleId = it->second.moduleId;
+        frame.moduleOffset = it->second.moduleOffset;
+    }
+
+private:
+
+    unsigned long internSymbol( const std::wstring& name )
+    {
+        std::unordered_map<std::wstring, unsigned long>::iterator  it = m_symbolIds.find(name);
+        if ( it != m_symbolIds.end() )
+            return it->second;
+
+        unsigned long  symbolId = static_cast<unsigned long>( m_result.symbols.size() );
+        m_result.symbols.push_back(name);
+        m_symbolIds.insert( std::make_pair( name, symbolId ) );
+        return symbolId;
+    }
+
+    unsigned long internModule( const std::wstring& name )
+    {
+        std::unordered_map<std::wstring, unsigned long>::iterator  it = m_moduleIds.find(name);
+        if ( it != m_moduleIds.end() )
+            return it->second;
+
+        unsigned long  moduleId = static_cast<unsigned long>( m_result.modules.size() );
+        m_result.modules.push_back(name);
+        m_moduleIds.insert( std::make_pair( name, moduleId ) );
+        return moduleId;
+    }
+
+    unsigned long findModule( kdlib::MEMOFFSET_64 offset, kdlib::MEMOFFSET_64& moduleBase )
+    {
+        std::map<kdlib::MEMOFFSET_64, ModuleRange>::iterator  it = m_moduleRanges.upper_bound(offset);
+        if ( it != m_moduleRanges.begin() )
+        {
+            --it;
+            if ( offset < it->second.end )
+            {
+                moduleBase = it->first;
+                return it->second.moduleId;
+            }
+        }
+
+        try {
+
+            kdlib::ModulePtr  module = kdlib::loadModule(offset);
+
+            ModuleRange  range = { module->getEnd(), internModule( module->getName() ) };
+            m_moduleRanges.insert( std::make_pair( module->getBase(), range ) );
+
+            moduleBase = module->getBase();
+            return range.moduleId;
+
+        } catch( kdlib::DbgException& )
+        {}
+
+        return StackWalkResult::noModule;
+    }
+
+    struct ModuleRange {
+        kdlib::MEMOFFSET_64  end;
+        unsigned long  moduleId;
+    };
+
+    StackWalkResult&  m_result;
+
+    std::unordered_map<std::wstring, unsigned long>  m_symbolIds;
+    std::unordered_map<std::wstring, unsigned long>  m_moduleIds;
+
+    std::unordered_map<kdlib::MEMOFFSET_64, StackWalkResult::FrameRow>  m_offsets;
+    std::map<kdlib::MEMOFFSET_64, ModuleRange>  m_moduleRanges;
+};
+
+// the walk switches the current process, it is restored at the end
+
+class CurrentThreadRestore {
+
+public:
+
+    CurrentThreadRestore()
+    {
+        try {
+            m_thread = kdlib::TargetThread::getCurrent();
+        } catch( kdlib::DbgException& )
+        {}
+    }
+
+    ~CurrentThreadRestore()
+    {
+        try {
+            if ( m_thread )
+                m_thread->setCurrent();
+        } catch( kdlib::DbgException& )
+        {}
+    }
+
+private:
+
+    kdlib::TargetThreadPtr  m_thread;
+};
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+StackWalkResultPtr walkAllStacks( const python::object& filter )
+{
+    StackWalkResultPtr  result( new StackWalkResult() );
+
+    bool  useFilter = !filter.is_none();
+
+    PyThreadState*  pystate;
+    AutoRestorePyState  restorePyState(&pystate);
+
+    CurrentThreadRestore  restoreThread;
+
+    StackSymbolizer  symbolizer(*result);
+
+    for ( unsigned long systemIndex = 0; systemIndex < kdlib::TargetSystem::getNumber(); ++systemIndex )
+    {
+        kdlib::TargetSystemPtr  system = kdlib::TargetSystem::getByIndex(systemIndex);
+
+        for ( unsigned long processIndex = 0; processIndex < system->getNumberProcesses(); ++processIndex )
+        {
+            kdlib::TargetProcessPtr  process = system->getProcessByIndex(processIndex);
+
+            try {
+                process->setCurrent();
+            } catch( kdlib::DbgException& )
+            {
+                continue;
+            }
+
+            symbolizer.setProcess();
+
+            kdlib::PROCESS_ID  pid = process->getSystemId();
+
+            for ( unsigned long threadIndex = 0; threadIndex < process->getNumberThreads(); ++threadIndex )
+            {
+                checkCancel();
+
+                kdlib::TargetThreadPtr  thread = process->getThreadByIndex(threadIndex);
+
+                StackWalkResult::ThreadRow  threadRow = { pid, thread->getSystemId(), result->frames.size(), 0, false };
+
+                if ( useFilter )
+                {
+                    AutoSavePythonState  savePyState(&pystate);
+                    if ( !python::extract<bool>( filter( threadRow.pid, threadRow.tid ) ) )
+                        continue;
+                }
+
+                try {
+
+                    kdlib::StackPtr  stack = thread->getStack();
+
+                    for ( unsigned long i = 0; i < stack->getFrameCount(); ++i )
+                    {
+                        kdlib::StackFramePtr  frame = stack->getFrame(i);
+
+                        StackWalkResult::FrameRow  frameRow = {};
+                        frameRow.ip = frame->getIP();
+                        frameRow.ret = frame->getRET();
+                        frameRow.sp = frame->getSP();
+                        frameRow.fp = frame->getFP();
+
+                        symbolizer.symbolize(frameRow);
+
+                        result->frames.push_back(frameRow);
+                    }
+
+                } catch( kdlib::DbgException& )
+                {
+                    threadRow.failed = true;
+                }
+
+                threadRow.frameCount = result->frames.size() - threadRow.firstFrame;
+                result->threads.push_back(threadRow);
+            }
+        }
+    }
+
+    return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::list StackWalkResult::getPids()
+{
+    python::list  lst;
+    for ( size_t i = 0; i < threads.size(); ++i )
+        lst.append( threads[i].pid );
+    return lst;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::list StackWalkResult::getTids()
+{
+    python::list  lst;
+    for ( size_t i = 0; i < threads.size(); ++i )
+        lst.append( threads[i].tid );
+    return lst;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::list StackWalkResult::getStackStarts()
+{
+    python::list  lst;
+    for ( size_t i = 0; i < threads.size(); ++i )
+        lst.append( threads[i].firstFrame );
+    return lst;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::list StackWalkResult::getStackSizes()
+{
+    python::list  lst;
+    for ( size_t i = 0; i < threads.size(); ++i )
+        lst.append( threads[i].frameCount );
+    return lst;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::list StackWalkResult::getFailed()
+{
+    python::list  lst;
+    for ( size_t i = 0; i < threads.size(); ++i )
+        lst.append( threads[i].failed );
+    return lst;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::list StackWalkResult::getIPs()
+{
+    python::list  lst;
+    for ( size_t i = 0; i < frames.size(); ++i )
+        lst.append( frames[i].ip );
+    return lst;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::list StackWalkResult::getRETs()
+{
+    python::list  lst;
+    for ( size_t i = 0; i < frames.size(); ++i )
+        lst.append( frames[i].ret );
+    return lst;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::list StackWalkResult::getSPs()
+{
+    python::list  lst;
+    for ( size_t i = 0; i < frames.size(); ++i )
+        lst.append( frames[i].sp );
+    return lst;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::list StackWalkResult::getFPs()
+{
+    python::list  lst;
+    for ( size_t i = 0; i < frames.size(); ++i )
+        lst.append( frames[i].fp );
+    return lst;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::list StackWalkResult::getSymbolIds()
+{
+    python::list  lst;
+    for ( size_t i = 0; i < frames.size(); ++i )
+        lst.append( frames[i].symbolId );
+    return lst;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::list StackWalkResult::getSymbols()
+{
+    python::list  lst;
+    for ( size_t i = 0; i < symbols.size(); ++i )
+        lst.append( symbols[i] );
+    return lst;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::list StackWalkResult::getModules()
+{
+    python::list  lst;
+    for ( size_t i = 0; i < modules.size(); ++i )
+        lst.append( modules[i] );
+    return lst;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::list StackWalkResult::getStack( size_t threadIndex )
+{
+    if ( threadIndex >= threads.size() )
+        throw kdlib::IndexException( static_cast<unsigned long>(threadIndex) );
+
+    python::list  lst;
+
+    const ThreadRow&  thread = threads[threadIndex];
+    for ( size_t i = thread.firstFrame; i < thread.firstFrame + thread.frameCount; ++i )
+        lst.append( python::make_tuple( frames[i].ip, symbols[ frames[i].symbolId ] ) );
+
+    return lst;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+std::wstring StackWalkResult::print()
+{
+    std::wstringstream  sstr;
+
+    for ( size_t t = 0; t < threads.size(); ++t )
+    {
+        const ThreadRow&  thread = threads[t];
+
+        sstr << L"Process: " << std::hex << thread.pid << L" Thread: " << std::hex << thread.tid;
+        if ( thread.failed )
+            sstr << L" (failed to get stack)";
+        sstr << std::endl;
+
+        for ( size_t i = thread.firstFrame; i < thread.firstFrame + thread.frameCount; ++i )
+            sstr << L"    " << std::hex << frames[i].ip << L"  " << symbols[ frames[i].symbolId ] << std::endl;
+    }
+
+    return sstr.str();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+// "module!function+1a" -> "module!function"
+std::wstring stripDisplacement( const std::wstring& symbol )
+{
+    size_t  pos = symbol.rfind(L'+');
+    if ( pos == std::wstring::npos || pos == 0 || pos + 1 == symbol.size() )
+        return symbol;
+
+    if ( symbol.find_first_not_of( L"0123456789abcdefABCDEF", pos + 1 ) != std::wstring::npos )
+        return symbol;
+
+    return symbol.substr( 0, pos );
+}
+
+struct StackKeyHash {
+    size_t operator()( const std::vector<kdlib::MEMOFFSET_64>& key ) const {
+        return boost::hash_range( key.begin(), key.end() );
+    }
+};
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+StackBucketsPtr aggregateStacks( const StackWalkResultPtr& walkResult, bool normalize )
+{
+    AutoRestorePyState  pystate;
+    return StackBucketsPtr( new StackBuckets( walkResult, normalize ) );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+StackBuckets::StackBuckets( const StackWalkResultPtr& walkResult, bool normalize ) :
+    m_walkResult( walkResult )
+{
+    const StackWalkResult&  result = *walkResult;
+
+    std::unordered_map<std::wstring, unsigned long>  functionIds;
+    m_functionIds.reserve( result.symbols.size() );
+
+    for ( size_t i = 0; i < result.symbols.size(); ++i )
+    {
+        std::wstring  function = stripDisplacement( result.symbols[i] );
+
+        std::unordered_map<std::wstring, unsigned long>::iterator  it = functionIds.find(function);
+        if ( it == functionIds.end() )
+        {
+            it = functionIds.insert( std::make_pair( function, static_cast<unsigned long>( m_functions.size() ) ) ).first;
+            m_functions.push_back(function);
+        }
+
+        m_functionIds.push_back( it->second );
+    }
+
+    std::unordered_map<std::vector<kdlib::MEMOFFSET_64>, size_t, StackKeyHash>  bucketIds;
+    std::vector<kdlib::MEMOFFSET_64>  key;
+
+    for ( size_t t = 0; t < result.threads.size(); ++t )
+    {
+        const StackWalkResult::ThreadRow&  thread = result.threads[t];
+        if ( thread.frameCount == 0 )
+            continue;
+
+        key.clear();
+
+        for ( size_t i = thread.firstFrame; i < thread.firstFrame + thread.frameCount; ++i )
+        {
+            const StackWalkResult::FrameRow&  frame = result.frames[i];
+            if ( normalize )
+            {
+                key.push_back( frame.moduleId );
+                key.push_back( frame.moduleOffset );
+            }
+            else
+            {
+                key.push_back( frame.ip );
+            }
+        }
+
+        std::unordered_map<std::vector<kdlib::MEMOFFSET_64>, size_t, StackKeyHash>::iterator  it = bucketIds.find(key);
+        if ( it == bucketIds.end() )
+        {
+            Bucket  bucket = { thread.firstFrame, thread.frameCount };
+            it = bucketIds.insert( std::make_pair( key, m_buckets.size() ) ).first;
+            m_buckets.push_back(bucket);
+        }
+
+        m_buckets[it->second].threads.push_back(t);
+    }
+
+    std::stable_sort( m_buckets.begin(), m_buckets.end(),
+        []( const Bucket& b1, const Bucket& b2 ) { return b1.threads.size() > b2.threads.size(); } );
+
+    buildCallTree();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void StackBuckets::buildCallTree()
+{
+    static const unsigned long  rootId = ~0UL;
+
+    CallTreeNode  root = { rootId, 0 };
+    m_callTree.push_back(root);
+
+    for ( size_t b = 0; b < m_buckets.size(); ++b )
+    {
+        const Bucket&  bucket = m_buckets[b];
+
+        size_t  nodeIndex = 0;
+        m_callTree[nodeIndex].count += bucket.threads.size();
+
+        // the outermost frame is the last one
+        for ( size_t i = bucket.firstFrame + bucket.frameCount; i > bucket.firstFrame; --i )
+        {
+            unsigned long  functionId = getFunctionId( m_walkResult->frames[i - 1].symbolId );
+
+            size_t  childIndex = 0;
+            for ( size_t c = 0; c < m_callTree[nodeIndex].children.size(); ++c )
+            {
+                if ( m_callTree[ m_callTree[nodeIndex].children[c] ].functionId == functionId )
+                {
+                    childIndex = m_callTree[nodeIndex].children[c];
+                    break;
+                }
+            }
+
+            if ( childIndex == 0 )
+            {
+                CallTreeNode  node = { functionId, 0 };
+                childIndex = m_callTree.size();
+                m_callTree.push_back(node);
+                m_callTree[nodeIndex].children.push_back(childIndex);
+            }
+
+            nodeIndex = childIndex;
+            m_callTree[nodeIndex].count += bucket.threads.size();
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+const StackBuckets::Bucket& StackBuckets::checkBucket( size_t bucketIndex ) const
+{
+    if ( bucketIndex >= m_buckets.size() )
+        throw kdlib::IndexException( static_cast<unsigned long>(bucketIndex) );
+
+    return m_buckets[bucketIndex];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+size_t StackBuckets::getCount( size_t bucketIndex )
+{
+    return checkBucket(bucketIndex).threads.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::list StackBuckets::getThreads( size_t bucketIndex )
+{
+    const Bucket&  bucket = checkBucket(bucketIndex);
+
+    python::list  lst;
+    for ( size_t i = 0; i < bucket.threads.size(); ++i )
+    {
+        const StackWalkResult::ThreadRow&  thread = m_walkResult->threads[ bucket.threads[i] ];
+        lst.append( python::make_tuple( thread.pid, thread.tid ) );
+    }
+
+    return lst;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::list StackBuckets::getStack( size_t bucketIndex )
+{
+    const Bucket&  bucket = checkBucket(bucketIndex);
+
+    python::list  lst;
+    for ( size_t i = bucket.firstFrame; i < bucket.firstFrame + bucket.frameCount; ++i )
+        lst.append( m_walkResult->symbols[ m_walkResult->frames[i].symbolId ] );
+
+    return lst;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::tuple StackBuckets::callTreeToPython( size_t nodeIndex )
+{
+    const CallTreeNode&  node = m_callTree[nodeIndex];
+
+    python::list  children;
+    for ( size_t i = 0; i < node.children.size(); ++i )
+        children.append( callTreeToPython( node.children[i] ) );
+
+    std::wstring  name = nodeIndex == 0 ? std::wstring() : m_functions[node.functionId];
+
+    return python::make_tuple( name, node.count, children );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::tuple StackBuckets::getCallTree()
+{
+    return callTreeToPython(0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+std::wstring StackBuckets::getFolded()
+{
+    AutoRestorePyState  pystate;
+
+    std::wstringstream  sstr;
+
+    // depth first, a line for each node with threads stopped right in it
+    std::vector< std::pair<size_t, size_t> >  path;   // node, next child
+    path.push_back( std::make_pair( 0, 0 ) );
+
+    while ( !path.empty() )
+    {
+        size_t  nodeIndex = path.back().first;
+        const CallTreeNode&  node = m_callTree[nodeIndex];
+
+        if ( path.back().second == 0 && nodeIndex != 0 )
+        {
+            size_t  childrenCount = 0;
+            for ( size_t i = 0; i < node.children.size(); ++i )
+                childrenCount += m_callTree[ node.children[i] ].count;
+
+            if ( node.count > childrenCount )
+            {
+                for ( size_t i = 1; i < path.size(); ++i )
+                {
+                    if ( i > 1 )
+                        sstr << L';';
+                    sstr << m_functions[ m_callTree[ path[i].first ].functionId ];
+                }
+
+                sstr << L' ' << std::dec << node.count - childrenCount << L'\n';
+            }
+        }
+
+        if ( path.back().second < node.children.size() )
+        {
+            size_t  childIndex = node.children[ path.back().second++ ];
+            path.push_back( std::make_pair( childIndex, 0 ) );
+        }
+        else
+        {
+            path.pop_back();
+        }
+    }
+
+    return sstr.str();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+std::wstring StackBuckets::print()
+{
+    AutoRestorePyState  pystate;
+
+    std::wstringstream  sstr;
+
+    for ( size_t b = 0; b < m_buckets.size(); ++b )
+    {
+        const Bucket&  bucket = m_buckets[b];
+
+        sstr << std::dec << bucket.threads.size() << L" thread(s):";
+        for ( size_t i = 0; i < bucket.threads.size(); ++i )
+            sstr << L' ' << std::hex << m_walkResult->threads[ bucket.threads[i] ].tid;
+        sstr << std::endl;
+
+        for ( size_t i = bucket.firstFrame; i < bucket.firstFrame + bucket.frameCount; ++i )
+            sstr << L"    " << m_walkResult->symbols[ m_walkResult->frames[i].symbolId ] << std::endl;
+    }
+
+    return sstr.str();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+// Module ranges of the current process sorted by base
+
+class ModuleRangeIndex {
+
+public:
+
+    ModuleRangeIndex()
+    {
+        kdlib::TargetProcessPtr  process = kdlib::TargetProcess::getCurrent();
+
+        for ( unsigned long i = 0; i < process->getNumberModules(); ++i )
+        {
+            kdlib::ModulePtr  module = process->getModuleByIndex(i);
+            Range  range = { module->getBase(), module->getEnd() };
+            m_ranges.push_back(range);
+        }
+
+        std::sort( m_ranges.begin(), m_ranges.end(),
+            []( const Range& r1, const Range& r2 ) { return r1.begin < r2.begin; } );
+    }
+
+    bool contains( kdlib::MEMOFFSET_64 offset ) const
+    {
+        std::vector<Range>::const_iterator  it = std::upper_bound( m_ranges.begin(), m_ranges.end(), offset,
+            []( kdlib::MEMOFFSET_64 off, const Range& range ) { return off < range.begin; } );
+
+        if ( it == m_ranges.begin() )
+            return false;
+
+        --it;
+        return offset < it->end;
+    }
+
+private:
+
+    struct Range {
+        kdlib::MEMOFFSET_64  begin;
+        kdlib::MEMOFFSET_64  end;
+    };
+
+    std::vector<Range>  m_ranges;
+};
+
+// Is there a call instruction right before the return address:
+// E8 rel32, FF /2 with any addressing form, with or without a REX prefix
+bool isPrecededByCall( kdlib::MEMOFFSET_64 retAddress )
+{
+    static const size_t  maxCallSize = 7;
+
+    std::vector<unsigned char>  code;
+    try {
+        code = kdlib::loadBytes( retAddress - maxCallSize, maxCallSize );
+    } catch( kdlib::DbgException& )
+    {
+        return false;
+    }
+
+    const unsigned char*  p = &code[0] + maxCallSize;
+
+    if ( p[-5] == 0xE8 )
+        return true;
+
+    // FF /2: modrm reg field is 2
+    struct CallForm {
+        size_t  size;
+        unsigned char  mod;
+        bool  sib;
+    };
+
+    static const CallForm  forms[] = {
+        { 2, 3, false },     // call reg
+        { 2, 0, false },     // call [reg]
+        { 3, 0, true },      // call [sib]
+        { 3, 1, false },     // call [reg+disp8]
+        { 4, 1, true },      // call [sib+disp8]
+        { 6, 0, false },     // call [disp32] / [rip+disp32]
+        { 6, 2, false },     // call [reg+disp32]
+        { 7, 2, true },      // call [sib+disp32]
+    };
+
+    for ( size_t i = 0; i < sizeof(forms) / sizeof(forms[0]); ++i )
+    {
+        const unsigned char*  instr = p - forms[i].size;
+        if ( instr[0] != 0xFF )
+            continue;
+
+        unsigned char  modrm = instr[1];
+        unsigned char  mod = modrm >> 6;
+        unsigned char  reg = ( modrm >> 3 ) & 7;
+        unsigned char  rm = modrm & 7;
+
+        if ( reg != 2 || mod != forms[i].mod )
+            continue;
+
+        if ( mod == 3 )
+            return true;
+
+        if ( forms[i].sib != ( rm == 4 ) )
+            continue;
+
+        // mod 0 and rm 5 is disp32 without a base register
+        if ( mod == 0 && rm == 5 && forms[i].size != 6 )
+            continue;
+        if ( mod == 0 && rm != 5 && forms[i].size == 6 )
+            continue;
+
+        return true;
+    }
+
+    return false;
+}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::list scanStack( kdlib::MEMOFFSET_64 begin, kdlib::MEMOFFSET_64 end, bool callOnly )
+{
+    struct StackPointer {
+        kdlib::MEMOFFSET_64  offset;
+        kdlib::MEMOFFSET_64  value;
+        std::wstring  symbol;
+    };
+
+    std::vector<StackPointer>  pointers;
+
+    do {
+
+        AutoRestorePyState  pystate;
+
+        if ( end <= begin )
+            break;
+
+        // the range is read at once and its size is passed as 32 bit
+        static const kdlib::MEMOFFSET_64  maxScanSize = 0x10000000;
+
+        if ( end - begin > maxScanSize )
+            throw kdlib::DbgException("stack range is too large");
+
+        size_t  ptrSize = kdlib::ptrSize();
+
+        begin &= ~static_cast<kdlib::MEMOFFSET_64>( ptrSize - 1 );
+
+        ModuleRangeIndex  modules;
+
+        std::unordered_map<kdlib::MEMOFFSET_64, std::wstring>  symbols;
+
+        // the same return address repeats through the stack, its code is read once
+        std::unordered_map<kdlib::MEMOFFSET_64, bool>  calls;
+
+        // one read for the whole range, page by page only if some pages are not readable
+        static const kdlib::MEMOFFSET_64  pageSize = 0x1000;
+
+        std::vector< std::pair< kdlib::MEMOFFSET_64, std::vector<unsigned char> > >  chunks;
+
+        try {
+            chunks.push_back( std::make_pair( begin, kdlib::loadBytes( begin, static_cast<unsigned long>( end - begin ) ) ) );
+        } catch( kdlib::MemoryException& )
+        {
+            for ( kdlib::MEMOFFSET_64 page = begin; page < end; page = ( page + pageSize ) & ~( pageSize - 1 ) )
+            {
+                checkCancel();
+
+                kdlib::MEMOFFSET_64  pageEnd = std::min( ( page + pageSize ) & ~( pageSize - 1 ), end );
+                try {
+                    chunks.push_back( std::make_pair( page, kdlib::loadBytes( page, static_cast<unsigned long>( pageEnd - page ) ) ) );
+                } catch( kdlib::MemoryException& )
+                {}
+            }
+        }
+
+        for ( size_t c = 0; c < chunks.size(); ++c )
+        {
+            const std::vector<unsigned char>&  bytes = chunks[c].second;
+
+            for ( size_t pos = 0; pos + ptrSize <= bytes.size(); pos += ptrSize )
+            {
+                if ( ( pos & ( pageSize - 1 ) ) == 0 )
+                    checkCancel();
+
+                kdlib::MEMOFFSET_64  value = 0;
+                memcpy( &value, &bytes[pos], ptrSize );
+
+                if ( !modules.contains(value) )
+                    continue;
+
+                if ( callOnly )
+                {
+                    std::unordered_map<kdlib::MEMOFFSET_64, bool>::iterator  call = calls.find(value);
+                    if ( call == calls.end() )
+                        call = calls.insert( std::make_pair( value, isPrecededByCall(value) ) ).first;
+
+                    if ( !call->second )
+                        continue;
+                }
+
+                std::unordered_map<kdlib::MEMOFFSET_64, std::wstring>::iterator  it = symbols.find(value);
+                if ( it == symbols.end() )
+                    it = symbols.insert( std::make_pair( value, formatSymbol(value) ) ).first;
+
+                StackPointer  pointer = { chunks[c].first + pos, value, it->second };
+                pointers.push_back(pointer);
+            }
+        }
+
+    } while(false);
+
+    python::list  lst;
+    for ( size_t i = 0; i < pointers.size(); ++i )
+        lst.append( python::make_tuple( pointers[i].offset, pointers[i].value, pointers[i].symbol ) );
+
+    return lst;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+} // end namespace pykd
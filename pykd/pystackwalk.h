@@ -0,0 +1,167 @@
+#pragma once
+
+#include <vector>
+
+#include <boost/python/list.hpp>
+#include <boost/python/tuple.hpp>
+#include <boost/shared_ptr.hpp>
+namespace python = boost::python;
+
+#include "kdlib/dbgengine.h"
+#include "kdlib/process.h"
+
+#include "pythreadstate.h"
+
+namespace pykd {
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Stacks of all threads of all target processes in a columnar form.
+// Thread columns are indexed by the thread number, frame columns by the frame
+// number over all stacks; stackStarts/stackSizes map threads onto frames.
+// Symbols and modules are interned in tables shared by all stacks
+
+class StackWalkResult {
+
+public:
+
+    struct ThreadRow {
+        kdlib::PROCESS_ID  pid;
+        kdlib::THREAD_ID  tid;
+        size_t  firstFrame;
+        size_t  frameCount;
+        bool  failed;
+    };
+
+    struct FrameRow {
+        kdlib::MEMOFFSET_64  ip;
+        kdlib::MEMOFFSET_64  ret;
+        kdlib::MEMOFFSET_64  sp;
+        kdlib::MEMOFFSET_64  fp;
+        unsigned long  symbolId;
+        unsigned long  moduleId;
+        kdlib::MEMOFFSET_64  moduleOffset;
+    };
+
+    static const unsigned long  noModule = ~0UL;
+
+    std::vector<ThreadRow>  threads;
+    std::vector<FrameRow>  frames;
+    std::vector<std::wstring>  symbols;
+    std::vector<std::wstring>  modules;
+
+    size_t getThreadCount() const {
+        return threads.size();
+    }
+
+    size_t getFrameCount() const {
+        return frames.size();
+    }
+
+    python::list getPids();
+
+    python::list getTids();
+
+    python::list getStackStarts();
+
+    python::list getStackSizes();
+
+    python::list getFailed();
+
+    python::list getIPs();
+
+    python::list getRETs();
+
+    python::list getSPs();
+
+    python::list getFPs();
+
+    python::list getSymbolIds();
+
+    python::list getSymbols();
+
+    python::list getModules();
+
+    python::list getStack( size_t threadIndex );
+
+    std::wstring print();
+};
+
+typedef boost::shared_ptr<StackWalkResult>  StackWalkResultPtr;
+
+StackWalkResultPtr walkAllStacks( const python::object& filter = python::object() );
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Groups identical stacks of a walk result. Stacks are compared by frame IPs
+// or, normalized, by module and offset inside the module, so the same code
+// path loaded at different addresses in different processes falls into one
+// bucket. Buckets are sorted by thread count, the biggest first
+
+class StackBuckets {
+
+public:
+
+    StackBuckets( const StackWalkResultPtr& walkResult, bool normalize );
+
+    size_t getBucketCount() const {
+        return m_buckets.size();
+    }
+
+    size_t getCount( size_t bucketIndex );
+
+    python::list getThreads( size_t bucketIndex );
+
+    python::list getStack( size_t bucketIndex );
+
+    python::tuple getCallTree();
+
+    std::wstring getFolded();
+
+    std::wstring print();
+
+private:
+
+    struct Bucket {
+        size_t  firstFrame;
+        size_t  frameCount;
+        std::vector<size_t>  threads;
+    };
+
+    struct CallTreeNode {
+        unsigned long  functionId;
+        size_t  count;
+        std::vector<size_t>  children;
+    };
+
+    const Bucket& checkBucket( size_t bucketIndex ) const;
+
+    unsigned long getFunctionId( unsigned long symbolId ) const {
+        return m_functionIds[symbolId];
+    }
+
+    void buildCallTree();
+
+    python::tuple callTreeToPython( size_t nodeIndex );
+
+    StackWalkResultPtr  m_walkResult;
+    std::vector<Bucket>  m_buckets;
+
+    // symbol names without displacement
+    std::vector<unsigned long>  m_functionIds;
+    std::vector<std::wstring>  m_functions;
+
+    std::vector<CallTreeNode>  m_callTree;
+};
+
+typedef boost::shared_ptr<StackBuckets>  StackBucketsPtr;
+
+StackBucketsPtr aggregateStacks( const StackWalkResultPtr& walkResult, bool normalize = false );
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::list scanStack( kdlib::MEMOFFSET_64 begin, kdlib::MEMOFFSET_64 end, bool callOnly = false );
+
+///////////////////////////////////////////////////////////////////////////////
+
+} // end namespace pykd
@@ -5,6 +5,7 @@
 
 #include "pytypeinfo.h"
 #include "pydataaccess.h"
+#include "pycancel.h"
 #include "kdlib/dataaccessor.h"
 
 
@@ -105,6 +106,21 @@ kdlib::TypedVarPtr getTypedVarByTypeInfo( const kdlib::TypeInfoPtr &typeInfo, py
 
 ///////////////////////////////////////////////////////////////////////////////
 
+python::list typedVarListToList( const kdlib::TypedVarList& lst )
+{
+    python::list  pyLst;
+
+    for ( kdlib::TypedVarList::const_iterator it = lst.begin(); it != lst.end(); ++it )
+    {
+        checkCancel();
+        pyLst.append( *it );
+    }
+
+    return pyLst;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 python::list getTypedVarListByTypeName( kdlib::MEMOFFSET_64 offset, const std::wstring &typeName, const std::wstring &fieldName )
 {
     kdlib::TypedVarList  lst;
@@ -114,7 +130,7 @@ python::list getTypedVarListByTypeName( kdlib::MEMOFFSET_64 offset, const std::w
         lst = kdlib::loadTypedVarList( offset, typeName, fieldName );
     } while(false);
 
-    return vectorToList( lst );
+    return typedVarListToList( lst );
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -128,7 +144,7 @@ python::list getTypedVarListByType( kdlib::MEMOFFSET_64 offset, kdlib::TypeInfoP
         lst = kdlib::loadTypedVarList( offset, typeInfo, fieldName );
     } while(false);
 
-    return vectorToList( lst );
+    return typedVarListToList( lst );
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -142,7 +158,7 @@ python::list getTypedVarArrayByTypeName( kdlib::MEMOFFSET_64 offset, const std::
         lst = kdlib::loadTypedVarArray( offset, typeName, number );
     } while(false);
 
-    return vectorToList( lst );
+    return typedVarListToList( lst );
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -156,7 +172,7 @@ python::list getTypedVarArrayByType( kdlib::MEMOFFSET_64 offset, kdlib::TypeInfo
         lst = kdlib::loadTypedVarArray( offset, typeInfo, number );
     } while(false);
 
-    return vectorToList( lst );
+    return typedVarListToList( lst );
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -41,6 +41,9 @@ inline kdlib::TypedVarPtr getTypedVarWithPrototype( const std::wstring &name, co
     return kdlib::loadTypedVar(name, prototype);
 }
 
+// converts a loaded list or array, checking for cancellation on each element
+python::list typedVarListToList( const kdlib::TypedVarList& lst );
+
 python::list getTypedVarListByTypeName( kdlib::MEMOFFSET_64 offset, const std::wstring &typeName, const std::wstring &fieldName );
 python::list getTypedVarListByType( kdlib::MEMOFFSET_64 offset, kdlib::TypeInfoPtr &typeInfo, const std::wstring &fieldName );
 python::list getTypedVarArrayByTypeName( kdlib::MEMOFFSET_64 offset, const std::wstring &typeName, size_t number );
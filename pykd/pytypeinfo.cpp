@@ -1,9 +1,19 @@
 #include "stdafx.h"
 
+#include <list>
+#include <map>
+#include <set>
+#include <tuple>
+#include <unordered_map>
+
+#include <boost/thread/mutex.hpp>
+
+#include "kdlib/dbgengine.h"
 #include "kdlib/module.h"
 #include "kdlib/exceptions.h"
 
 #include "pytypeinfo.h"
+#include "pydbgeng.h"
 #include "variant.h"
 
 namespace pykd {
@@ -13,9 +23,25 @@ namespace pykd {
 std::wstring findSymbol(  kdlib::MEMOFFSET_64 offset, bool showDisplacement ) 
 {
     AutoRestorePyState  pystate;
+    return formatSymbol( offset, showDisplacement );
+}
 
+///////////////////////////////////////////////////////////////////////////////
+
+std::wstring formatSymbol( kdlib::MEMOFFSET_64 offset, bool showDisplacement )
+{
     kdlib::MEMDISPLACEMENT  displacement = 0;
     std::wstring  symbolName;
+    std::wstring  moduleName;
+
+    if ( lookupSyntheticSymbol( offset, moduleName, symbolName, displacement ) )
+    {
+        std::wstringstream  sstr;
+        sstr << moduleName << L'!' << symbolName;
+        if ( showDisplacement && displacement != 0 )
+            sstr << L'+' << std::hex << displacement;
+        return sstr.str();
+    }
 
     try {
 
@@ -75,6 +101,227 @@ python::tuple findSymbolAndDisp( ULONG64 offset )
 
 ///////////////////////////////////////////////////////////////////////////////
 
+namespace {
+
+// LRU cache of providers built by clang from the source code.
+// The key is the compile options and the source text, so the same header
+// compiled with the same options is parsed only once
+template<typename TProvider>
+class SourceCache
+{
+public:
+
+    struct Entry
+    {
+        TProvider  provider;
+        std::string  errorOutput;
+    };
+
+    bool find(const std::wstring& key, Entry& entry)
+    {
+        boost::mutex::scoped_lock  lock(m_lock);
+
+        auto  it = m_index.find(key);
+        if (it == m_index.end())
+            return false;
+
+        m_lru.splice(m_lru.begin(), m_lru, it->second);
+        entry = it->second->second;
+        return true;
+    }
+
+    void insert(const std::wstring& key, const Entry& entry)
+    {
+        boost::mutex::scoped_lock  lock(m_lock);
+
+        if (m_maxSize == 0)
+            return;
+
+        auto  it = m_index.find(key);
+        if (it != m_index.end())
+        {
+            m_lru.erase(it->second);
+            m_index.erase(it);
+        }
+
+        m_lru.push_front(std::make_pair(key, entry));
+        m_index[key] = m_lru.begin();
+
+        shrink();
+    }
+
+    void setMaxSize(size_t maxSize)
+    {
+        boost::mutex::scoped_lock  lock(m_lock);
+        m_maxSize = maxSize;
+        shrink();
+    }
+
+    void clear()
+    {
+        boost::mutex::scoped_lock  lock(m_lock);
+        m_index.clear();
+        m_lru.clear();
+    }
+
+private:
+
+    typedef std::list< std::pair<std::wstring, Entry> >  LruList;
+
+    void shrink()
+    {
+        while (m_lru.size() > m_maxSize)
+        {
+            m_index.erase(m_lru.back().first);
+            m_lru.pop_back();
+        }
+    }
+
+    boost::mutex  m_lock;
+
+    size_t  m_maxSize = 16;
+
+    LruList  m_lru;
+
+    std::unordered_map<std::wstring, typename LruList::iterator>  m_index;
+};
+
+SourceCache<kdlib::TypeInfoProviderPtr>  g_typeProviderCache;
+SourceCache<kdlib::SymbolProviderPtr>  g_symbolProviderCache;
+
+std::wstring getSourceCacheKey(const std::wstring& sourceCode, const std::wstring& compileOptions)
+{
+    std::wstring  key;
+    key.reserve(compileOptions.size() + sourceCode.size() + 1);
+    key.append(compileOptions);
+    key.push_back(L'\0');
+    key.append(sourceCode);
+    return key;
+}
+
+SourceCache<kdlib::TypeInfoProviderPtr>::Entry compileTypeProvider(const std::wstring& sourceCode, const std::wstring& compileOptions)
+{
+    std::wstring  key = getSourceCacheKey(sourceCode, compileOptions);
+
+    SourceCache<kdlib::TypeInfoProviderPtr>::Entry  entry;
+
+    if (!g_typeProviderCache.find(key, entry))
+    {
+        entry.provider = kdlib::getTypeInfoProviderFromSource(sourceCode, entry.errorOutput, compileOptions);
+        g_typeProviderCache.insert(key, entry);
+    }
+
+    return entry;
+}
+
+// A cached provider is returned as the same Python object while that object
+// is alive. The objects are kept in a weak dictionary of the pykd module, so
+// every interpreter has its own one. The GIL must be held
+template<typename ProviderPtr>
+python::object getProviderObject(const ProviderPtr& provider)
+{
+    python::object  pykd = python::import("pykd");
+
+    if (!PyObject_HasAttrString(pykd.ptr(), "_sourceProviders"))
+        pykd.attr("_sourceProviders") = python::import("weakref").attr("WeakValueDictionary")();
+
+    python::object  objects = pykd.attr("_sourceProviders");
+    python::object  key(reinterpret_cast<size_t>(provider.get()));
+    python::object  obj = objects.attr("get")(key);
+
+    if (obj.is_none())
+    {
+        obj = python::object(provider);
+        objects[key] = obj;
+    }
+
+    return obj;
+}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+kdlib::TypeInfoPtr getTypeFromSource( const std::wstring& sourceCode, const std::wstring& typeName, const std::wstring& compileOptions)
+{
+    AutoRestorePyState  pystate;
+    return compileTypeProvider(sourceCode, compileOptions).provider->getTypeByName(typeName);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::object getTypeInfoProviderFromSource(const std::wstring& sourceCode, const std::wstring& compileOptions)
+{
+    SourceCache<kdlib::TypeInfoProviderPtr>::Entry  entry;
+
+    do {
+        FlushedEngineCall  engineCall;
+
+        entry = compileTypeProvider(sourceCode, compileOptions);
+
+        if (entry.errorOutput.size())
+            kdlib::dprint(kdlib::strToWStr(entry.errorOutput));
+    } while (false);
+
+    return getProviderObject(entry.provider);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::tuple getTypeInfoProviderFromSourceEx(const std::wstring& sourceCode, const std::wstring& compileOptions)
+{
+    SourceCache<kdlib::TypeInfoProviderPtr>::Entry  entry;
+
+    do {
+        AutoRestorePyState  pystate;
+        entry = compileTypeProvider(sourceCode, compileOptions);
+    } while (false);
+
+    return python::make_tuple(getProviderObject(entry.provider), kdlib::strToWStr(entry.errorOutput));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+python::object getSymbolProviderFromSource(const std::wstring& sourceCode, const std::wstring& compileOptions)
+{
+    std::wstring  key = getSourceCacheKey(sourceCode, compileOptions);
+
+    SourceCache<kdlib::SymbolProviderPtr>::Entry  entry;
+
+    do {
+        FlushedEngineCall  engineCall;
+
+        if (!g_symbolProviderCache.find(key, entry))
+        {
+            entry.provider = kdlib::getSymbolProviderFromSource(sourceCode, entry.errorOutput, compileOptions);
+            g_symbolProviderCache.insert(key, entry);
+        }
+
+        if (entry.errorOutput.size())
+            kdlib::dprint(kdlib::strToWStr(entry.errorOutput));
+    } while (false);
+
+    return getProviderObject(entry.provider);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void setSourceCacheSize(size_t maxEntries)
+{
+    g_typeProviderCache.setMaxSize(maxEntries);
+    g_symbolProviderCache.setMaxSize(maxEntries);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void clearSourceCache()
+{
+    g_typeProviderCache.clear();
+    g_symbolProviderCache.clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 python::list TypeInfoAdapter::getFields( const kdlib::TypeInfoPtr &typeInfo )
 {
     typedef boost::tuple<std::wstring,kdlib::TypeInfoPtr> FieldTuple;
@@ -532,4 +779,156 @@ kdlib::TypeInfoPtr TypeInfoProviderAdapter::getTypeAsAttr(kdlib::TypeInfoProvide
 
 ///////////////////////////////////////////////////////////////////////////////
 
+kdlib::TypeInfoPtr TypeInfoAdapter::ptrTo( kdlib::TypeInfo &typeInfo, size_t ptrSize )
+{
+    if (BaseTypesEnum::isInterned(typeInfo))
+        return BaseTypesEnum::getPtrTo(typeInfo, ptrSize);
+
+    AutoRestorePyState  pystate;
+    return typeInfo.ptrTo(ptrSize);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+kdlib::TypeInfoPtr TypeInfoAdapter::arrayOf( kdlib::TypeInfo &typeInfo, size_t size )
+{
+    if (BaseTypesEnum::isInterned(typeInfo))
+        return BaseTypesEnum::getArrayOf(typeInfo, size);
+
+    AutoRestorePyState  pystate;
+    return typeInfo.arrayOf(size);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+kdlib::TypeInfoPtr  g_baseTypes[BaseTypesEnum::TypeIdCount];
+
+std::map<size_t, kdlib::TypeInfoPtr>  g_voidPtrTypes;
+
+// ( base type, is array, pointer size or element count )
+typedef std::tuple<const kdlib::TypeInfo*, bool, size_t>  DerivedTypeKey;
+
+std::map<DerivedTypeKey, kdlib::TypeInfoPtr>  g_derivedTypes;
+
+// all types returned from the tables above: only they are memoized by ptrTo/arrayOf
+std::set<const kdlib::TypeInfo*>  g_internedTypes;
+
+const size_t  maxDerivedTypes = 0x1000;
+
+kdlib::TypeInfoPtr internDerivedType(const DerivedTypeKey& key, const kdlib::TypeInfoPtr& typeInfo)
+{
+    auto  it = g_derivedTypes.find(key);
+    if (it != g_derivedTypes.end())
+        return it->second;
+
+    if (g_derivedTypes.size() < maxDerivedTypes)
+    {
+        g_derivedTypes.insert(std::make_pair(key, typeInfo));
+        g_internedTypes.insert(typeInfo.get());
+    }
+
+    return typeInfo;
+}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+kdlib::TypeInfoPtr BaseTypesEnum::getBaseType(TypeId typeId, const wchar_t* typeName)
+{
+    if (g_baseTypes[typeId])
+        return g_baseTypes[typeId];
+
+    kdlib::TypeInfoPtr  typeInfo = pykd::getTypeInfoByName(typeName);
+
+    if (!g_baseTypes[typeId])
+    {
+        g_baseTypes[typeId] = typeInfo;
+        g_internedTypes.insert(typeInfo.get());
+    }
+
+    return g_baseTypes[typeId];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+kdlib::TypeInfoPtr BaseTypesEnum::getVoidPtr()
+{
+    size_t  ptrSize;
+
+    {
+        AutoRestorePyState  pystate;
+        ptrSize = kdlib::ptrSize();
+    }
+
+    auto  it = g_voidPtrTypes.find(ptrSize);
+    if (it != g_voidPtrTypes.end())
+        return it->second;
+
+    kdlib::TypeInfoPtr  typeInfo = pykd::getTypeInfoByName(L"Void*");
+
+    auto  inserted = g_voidPtrTypes.insert(std::make_pair(ptrSize, typeInfo));
+    if (inserted.second)
+        g_internedTypes.insert(typeInfo.get());
+
+    return inserted.first->second;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool BaseTypesEnum::isInterned(const kdlib::TypeInfo& typeInfo)
+{
+    return g_internedTypes.find(&typeInfo) != g_internedTypes.end();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+kdlib::TypeInfoPtr BaseTypesEnum::getPtrTo(kdlib::TypeInfo& typeInfo, size_t ptrSize)
+{
+    if (ptrSize == 0)
+    {
+        AutoRestorePyState  pystate;
+        ptrSize = kdlib::ptrSize();
+    }
+
+    DerivedTypeKey  key(&typeInfo, false, ptrSize);
+
+    auto  it = g_derivedTypes.find(key);
+    if (it != g_derivedTypes.end())
+        return it->second;
+
+    kdlib::TypeInfoPtr  ptrType;
+
+    {
+        AutoRestorePyState  pystate;
+        ptrType = typeInfo.ptrTo(ptrSize);
+    }
+
+    return internDerivedType(key, ptrType);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+kdlib::TypeInfoPtr BaseTypesEnum::getArrayOf(kdlib::TypeInfo& typeInfo, size_t size)
+{
+    DerivedTypeKey  key(&typeInfo, true, size);
+
+    auto  it = g_derivedTypes.find(key);
+    if (it != g_derivedTypes.end())
+        return it->second;
+
+    kdlib::TypeInfoPtr  arrayType;
+
+    {
+        AutoRestorePyState  pystate;
+        arrayType = typeInfo.arrayOf(size);
+    }
+
+    return internDerivedType(key, arrayType);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 } // pykd namespace
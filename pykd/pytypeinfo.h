@@ -22,6 +22,9 @@ inline kdlib::MEMOFFSET_64 getSymbolOffset( const std::wstring &name )
 
 std::wstring findSymbol(  kdlib::MEMOFFSET_64 offset, bool showDisplacement = true );
 
+// the same as findSymbol, must be called without the GIL
+std::wstring formatSymbol( kdlib::MEMOFFSET_64 offset, bool showDisplacement = true );
+
 python::tuple findSymbolAndDisp( ULONG64 offset );
 
 inline size_t getSymbolSize( const std::wstring &name )
@@ -62,55 +65,17 @@ inline kdlib::TypeInfoPtr getTypeInfoByName( const std::wstring &name )
     return kdlib::loadType( name );
 }
 
-inline kdlib::TypeInfoPtr getTypeFromSource( const std::wstring& sourceCode, const std::wstring& typeName, const std::wstring& compileOptions=L"")
-{
-    AutoRestorePyState  pystate;
-    return kdlib::compileType( sourceCode, typeName, compileOptions);
-}
+kdlib::TypeInfoPtr getTypeFromSource( const std::wstring& sourceCode, const std::wstring& typeName, const std::wstring& compileOptions=L"");
 
-inline kdlib::TypeInfoProviderPtr getTypeInfoProviderFromSource(const std::wstring& sourceCode, const std::wstring& compileOptions=L"")
-{
-    AutoRestorePyState  pystate;
-	std::string errorOutput;
-	kdlib::TypeInfoProviderPtr ret = kdlib::getTypeInfoProviderFromSource(sourceCode, errorOutput, compileOptions);
+python::object getTypeInfoProviderFromSource(const std::wstring& sourceCode, const std::wstring& compileOptions=L"");
 
-	if (errorOutput.size()) {
-		std::wstring errorOutputWstring = kdlib::strToWStr(errorOutput); //(errorOutput.begin(), errorOutput.end());
-		kdlib::dprint(errorOutputWstring);
-	}
+python::tuple getTypeInfoProviderFromSourceEx(const std::wstring& sourceCode, const std::wstring& compileOptions = L"");
 
-	return ret;
-}
-
-inline python::tuple getTypeInfoProviderFromSourceEx(const std::wstring& sourceCode, const std::wstring& compileOptions = L"")
-{
-	kdlib::TypeInfoProviderPtr ret;
-	std::string errorOutput;
-
-	do {
-		AutoRestorePyState  pystate;
-		ret = kdlib::getTypeInfoProviderFromSource(sourceCode, errorOutput, compileOptions);
-	} while (false);
-
-	//python::list retList;
-	//retList.append(ret);
-	//retList.append(kdlib::strToWStr(errorOutput));
-	//return retList;
-	return python::make_tuple(ret, kdlib::strToWStr(errorOutput));
-}
+python::object getSymbolProviderFromSource(const std::wstring& sourceCode, const std::wstring& compileOptions = L"");
 
-inline kdlib::SymbolProviderPtr getSymbolProviderFromSource(const std::wstring& sourceCode, const std::wstring& compileOptions = L"")
-{
-    AutoRestorePyState  pystate;
-	std::string errorOutput;
-    kdlib::SymbolProviderPtr ret = kdlib::getSymbolProviderFromSource(sourceCode, errorOutput, compileOptions);
-	if (errorOutput.size()) {
-		std::wstring errorOutputWstring = kdlib::strToWStr(errorOutput);
-		kdlib::dprint(errorOutputWstring);
-	}
+void setSourceCacheSize(size_t maxEntries);
 
-	return ret;
-}
+void clearSourceCache();
 
 inline kdlib::TypeInfoProviderPtr getTypeInfoProviderFromPdb(const std::wstring&  fileName, kdlib::MEMOFFSET_64 offset = 0UL)
 {
@@ -291,11 +256,7 @@ struct TypeInfoAdapter : public kdlib::TypeInfo {
         return typeInfo.getBaseClassOffset(index);
     }
 
-    static kdlib::TypeInfoPtr ptrTo( kdlib::TypeInfo &typeInfo, size_t ptrSize = 0 ) 
-    {
-        AutoRestorePyState  pystate;
-        return typeInfo.ptrTo(ptrSize);
-    }
+    static kdlib::TypeInfoPtr ptrTo( kdlib::TypeInfo &typeInfo, size_t ptrSize = 0 );
 
     static kdlib::TypeInfoPtr deref( kdlib::TypeInfo &typeInfo )
     {
@@ -303,11 +264,7 @@ struct TypeInfoAdapter : public kdlib::TypeInfo {
         return typeInfo.deref();
     }
 
-    static kdlib::TypeInfoPtr arrayOf( kdlib::TypeInfo &typeInfo, size_t size ) 
-    {
-        AutoRestorePyState  pystate;
-        return typeInfo.arrayOf(size);
-    }
+    static kdlib::TypeInfoPtr arrayOf( kdlib::TypeInfo &typeInfo, size_t size );
 
     static bool isArray( kdlib::TypeInfo &typeInfo )
     {
@@ -536,22 +493,41 @@ struct SymbolProviderAdapter
 };
 
 struct BaseTypesEnum {
-    static kdlib::TypeInfoPtr getUInt1B() { return pykd::getTypeInfoByName(L"UInt1B"); }
-    static kdlib::TypeInfoPtr getUInt2B() { return pykd::getTypeInfoByName(L"UInt2B");  }
-    static kdlib::TypeInfoPtr getUInt4B() { return pykd::getTypeInfoByName(L"UInt4B");  }
-    static kdlib::TypeInfoPtr getUInt8B() { return pykd::getTypeInfoByName(L"UInt8B");  }
-    static kdlib::TypeInfoPtr getInt1B() { return pykd::getTypeInfoByName(L"Int1B"); }
-    static kdlib::TypeInfoPtr getInt2B() { return pykd::getTypeInfoByName(L"Int2B"); }
-    static kdlib::TypeInfoPtr getInt4B() { return pykd::getTypeInfoByName(L"Int4B"); }
-    static kdlib::TypeInfoPtr getInt8B() { return pykd::getTypeInfoByName(L"Int8B"); }
-    static kdlib::TypeInfoPtr getLong() { return pykd::getTypeInfoByName(L"Long"); }
-    static kdlib::TypeInfoPtr getULong() { return pykd::getTypeInfoByName(L"ULong"); }
-    static kdlib::TypeInfoPtr getBool() { return pykd::getTypeInfoByName(L"Bool"); }
-    static kdlib::TypeInfoPtr getChar() { return pykd::getTypeInfoByName(L"Char"); }
-    static kdlib::TypeInfoPtr getWChar() { return pykd::getTypeInfoByName(L"WChar"); }
-    static kdlib::TypeInfoPtr getVoidPtr() { return pykd::getTypeInfoByName(L"Void*"); }
-    static kdlib::TypeInfoPtr getFloat() { return pykd::getTypeInfoByName(L"Float"); }
-    static kdlib::TypeInfoPtr getDouble() { return pykd::getTypeInfoByName(L"Double"); }
+
+    enum TypeId {
+        TypeUInt1B, TypeUInt2B, TypeUInt4B, TypeUInt8B,
+        TypeInt1B, TypeInt2B, TypeInt4B, TypeInt8B,
+        TypeLong, TypeULong, TypeBool, TypeChar, TypeWChar,
+        TypeFloat, TypeDouble,
+        TypeIdCount
+    };
+
+    static kdlib::TypeInfoPtr getUInt1B() { return getBaseType(TypeUInt1B, L"UInt1B"); }
+    static kdlib::TypeInfoPtr getUInt2B() { return getBaseType(TypeUInt2B, L"UInt2B");  }
+    static kdlib::TypeInfoPtr getUInt4B() { return getBaseType(TypeUInt4B, L"UInt4B");  }
+    static kdlib::TypeInfoPtr getUInt8B() { return getBaseType(TypeUInt8B, L"UInt8B");  }
+    static kdlib::TypeInfoPtr getInt1B() { return getBaseType(TypeInt1B, L"Int1B"); }
+    static kdlib::TypeInfoPtr getInt2B() { return getBaseType(TypeInt2B, L"Int2B"); }
+    static kdlib::TypeInfoPtr getInt4B() { return getBaseType(TypeInt4B, L"Int4B"); }
+    static kdlib::TypeInfoPtr getInt8B() { return getBaseType(TypeInt8B, L"Int8B"); }
+    static kdlib::TypeInfoPtr getLong() { return getBaseType(TypeLong, L"Long"); }
+    static kdlib::TypeInfoPtr getULong() { return getBaseType(TypeULong, L"ULong"); }
+    static kdlib::TypeInfoPtr getBool() { return getBaseType(TypeBool, L"Bool"); }
+    static kdlib::TypeInfoPtr getChar() { return getBaseType(TypeChar, L"Char"); }
+    static kdlib::TypeInfoPtr getWChar() { return getBaseType(TypeWChar, L"WChar"); }
+    static kdlib::TypeInfoPtr getVoidPtr();
+    static kdlib::TypeInfoPtr getFloat() { return getBaseType(TypeFloat, L"Float"); }
+    static kdlib::TypeInfoPtr getDouble() { return getBaseType(TypeDouble, L"Double"); }
+
+    // base types and pointers/arrays built from them are immutable, so they are
+    // loaded once and shared. All the tables are guarded by the GIL
+    static kdlib::TypeInfoPtr getBaseType(TypeId typeId, const wchar_t* typeName);
+
+    static bool isInterned(const kdlib::TypeInfo& typeInfo);
+
+    static kdlib::TypeInfoPtr getPtrTo(kdlib::TypeInfo& typeInfo, size_t ptrSize);
+
+    static kdlib::TypeInfoPtr getArrayOf(kdlib::TypeInfo& typeInfo, size_t size);
 };
 
 } // end namespace pykd
@@ -2,6 +2,10 @@
 
 #include <comutil.h>
 
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
 #include <boost/python.hpp>
 namespace python = boost::python;
 
@@ -11,8 +15,11 @@ namespace python = boost::python;
 #include "windbgext.h"
 #include "dbgexcept.h"
 #include "pydbgio.h"
+#include "pycancel.h"
+#include "pyeventhandler.h"
 
 #include <python.h>
+#include <marshal.h>
 
 using namespace kdlib::windbg;
 
@@ -85,6 +92,20 @@ void PykdExt::tearDown()
 {
     PyEval_RestoreThread( m_pyState );
 
+    // event handlers may have printed since the last command
+    pykd::flushDbgOut();
+
+    while ( !m_localInterpreters.empty() )
+    {
+        PyThreadState_Swap( m_localInterpreters.back()->state );
+
+        destroyLocalInterpreter( m_localInterpreters.back() );
+
+        m_localInterpreters.pop_back();
+    }
+
+    PyThreadState_Swap( m_pyState );
+
     Py_Finalize();
 
     WindbgExtension::tearDown();
@@ -141,18 +162,26 @@ KDLIB_EXT_COMMAND_METHOD_IMPL(PykdExt, py)
         global = !(global || local ) ? true : global ; //set global by default
     }
 
-    PyThreadState   *localState = NULL;
+    LocalInterpreter  *localInterpreter = NULL;
     PyThreadState   *globalState = NULL;
 
+    pykd::resetCancel();
+
     PyEval_RestoreThread( m_pyState );
 
     if ( !global )
     {
         globalState =  PyThreadState_Swap(NULL);
 
-        Py_NewInterpreter();
+        localInterpreter = acquireLocalInterpreter();
 
-        localState = PyThreadState_Get();
+        if ( !localInterpreter )
+        {
+            PyThreadState_Swap( globalState );
+            m_pyState = PyEval_SaveThread();
+            kdlib::eprintln( L"failed to create python interpreter" );
+            return;
+        }
 
         python::object       sys = python::import("sys");
 
@@ -212,7 +241,7 @@ KDLIB_EXT_COMMAND_METHOD_IMPL(PykdExt, py)
 
         try {
             PykdInterruptWatch  interruptWatch;
-            python::exec_file( scriptFileName.c_str(), global );
+            execScript( scriptFileName, global );
         }
         catch( const python::error_already_set& )
         {
@@ -220,36 +249,219 @@ KDLIB_EXT_COMMAND_METHOD_IMPL(PykdExt, py)
         }
         catch (const std::exception& invalidArg)
         {
+            pykd::flushDbgOut();
             _bstr_t    bstrInavalidArg(invalidArg.what());
             kdlib::eprintln(std::wstring(bstrInavalidArg));
         }
 
+        pykd::flushDbgOut();
+
     }
 
     if ( !global )
     {
-        PyInterpreterState  *interpreter = localState->interp;
+        releaseLocalInterpreter( localInterpreter );
 
-        //while( interpreter->tstate_head != NULL )
-        //{
-        //    PyThreadState   *threadState = (PyThreadState*)(interpreter->tstate_head);
+        PyThreadState_Swap( globalState );
+    }
 
-        //    PyThreadState_Clear(threadState);
+    m_pyState = PyEval_SaveThread();
 
-        //    PyThreadState_Swap( NULL );
+}
 
-        //    PyThreadState_Delete(threadState);
-        //}
-    
-        PyInterpreterState_Clear(interpreter);
+///////////////////////////////////////////////////////////////////////////////
 
-        PyInterpreterState_Delete(interpreter);
+// Scripts are compiled once and kept marshaled. The cache entry is valid while
+// the file has the same modification time and size
 
-        PyThreadState_Swap( globalState );
+void PykdExt::execScript( const std::string &scriptFileName, python::object &global )
+{
+    WIN32_FILE_ATTRIBUTE_DATA  fileData;
+    if ( !GetFileAttributesExA( scriptFileName.c_str(), GetFileExInfoStandard, &fileData ) )
+        throw std::invalid_argument( scriptFileName + " : no such file" );
+
+    unsigned long long  writeTime = ( (unsigned long long)fileData.ftLastWriteTime.dwHighDateTime << 32 ) | fileData.ftLastWriteTime.dwLowDateTime;
+    unsigned long long  size = ( (unsigned long long)fileData.nFileSizeHigh << 32 ) | fileData.nFileSizeLow;
+
+    std::string  key = scriptFileName;
+
+    char  fullPath[MAX_PATH];
+    DWORD  fullPathLength = GetFullPathNameA( scriptFileName.c_str(), MAX_PATH, fullPath, NULL );
+    if ( fullPathLength > 0 && fullPathLength < MAX_PATH )
+        key.assign( fullPath, fullPathLength );
+
+    std::transform( key.begin(), key.end(), key.begin(), ::tolower );
+
+    python::object  code;
+
+    std::map<std::string, CompiledScript>::const_iterator  it = m_scriptCache.find( key );
+    if ( it != m_scriptCache.end() && it->second.writeTime == writeTime && it->second.size == size )
+    {
+        code = python::object( python::handle<>( PyMarshal_ReadObjectFromString(
+            const_cast<char*>( it->second.code.data() ), (Py_ssize_t)it->second.code.size() ) ) );
     }
+    else
+    {
+        std::ifstream  file( scriptFileName.c_str() );
+        if ( !file )
+            throw std::invalid_argument( scriptFileName + " : no such file" );
 
-    m_pyState = PyEval_SaveThread();
+        std::string  source( ( std::istreambuf_iterator<char>(file) ), std::istreambuf_iterator<char>() );
+
+        code = python::object( python::handle<>( Py_CompileString( source.c_str(), scriptFileName.c_str(), Py_file_input ) ) );
+
+        python::handle<>  marshaled( PyMarshal_WriteObjectToString( code.ptr(), Py_MARSHAL_VERSION ) );
+
+        CompiledScript  &compiled = m_scriptCache[key];
+        compiled.writeTime = writeTime;
+        compiled.size = size;
+        compiled.code.assign( PyBytes_AS_STRING( marshaled.get() ), PyBytes_GET_SIZE( marshaled.get() ) );
+    }
 
+#if PY_VERSION_HEX >= 0x03000000
+    python::handle<>  result( PyEval_EvalCode( code.ptr(), global.ptr(), global.ptr() ) );
+#else
+    python::handle<>  result( PyEval_EvalCode( (PyCodeObject*)code.ptr(), global.ptr(), global.ptr() ) );
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Creating a sub-interpreter and importing pykd into it takes much longer than
+// most scripts run, so the interpreters are reused. After a script run the
+// main namespace, sys.modules, the import machinery lists (sys.path,
+// sys.meta_path, sys.path_hooks, sys.path_importer_cache) and sys.argv are
+// restored to the state they had right after the creation, and the
+// setBreakpoints breakpoints of the script are removed. An interpreter with
+// event handlers or breakpoint objects still alive after that is destroyed
+// instead of pooled. Other process-wide state a script changes (os.environ,
+// the working directory, native module globals, threads it started) is not
+// restored
+
+static const size_t  localInterpreterPoolSize = 4;
+
+///////////////////////////////////////////////////////////////////////////////
+
+PykdExt::LocalInterpreter* PykdExt::acquireLocalInterpreter()
+{
+    if ( !m_localInterpreters.empty() )
+    {
+        LocalInterpreter  *interpreter = m_localInterpreters.back();
+        m_localInterpreters.pop_back();
+
+        PyThreadState_Swap( interpreter->state );
+
+        return interpreter;
+    }
+
+    PyThreadState  *state = Py_NewInterpreter();
+    if ( !state )
+        return NULL;
+
+    LocalInterpreter  *interpreter = new LocalInterpreter();
+    interpreter->state = state;
+
+    try {
+
+        python::object  sys = python::import("sys");
+
+        python::import( "pykd" );
+
+        interpreter->mainDict = python::dict( python::import("__main__").attr("__dict__") );
+        interpreter->modules = python::dict( sys.attr("modules") );
+        interpreter->path = python::list( sys.attr("path") );
+        interpreter->metaPath = python::list( sys.attr("meta_path") );
+        interpreter->pathHooks = python::list( sys.attr("path_hooks") );
+        interpreter->pathImporterCache = python::dict( sys.attr("path_importer_cache") );
+        interpreter->argv = python::list( sys.attr("argv") );
+    }
+    catch( const python::error_already_set& )
+    {
+        pykd::printException();
+    }
+
+    return interpreter;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void PykdExt::releaseLocalInterpreter( LocalInterpreter *interpreter )
+{
+    if ( m_localInterpreters.size() < localInterpreterPoolSize && resetLocalInterpreter( interpreter ) )
+    {
+        m_localInterpreters.push_back( interpreter );
+        return;
+    }
+
+    destroyLocalInterpreter( interpreter );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool PykdExt::resetLocalInterpreter( LocalInterpreter *interpreter )
+{
+    // pykd import failed, the interpreter has no snapshot
+    if ( python::len( interpreter->modules ) == 0 )
+        return false;
+
+    try {
+
+        python::object  sys = python::import("sys");
+
+        python::object  modules = sys.attr("modules");
+        modules.attr("clear")();
+        modules.attr("update")( interpreter->modules );
+
+        python::object  mainDict = python::import("__main__").attr("__dict__");
+        mainDict.attr("clear")();
+        mainDict.attr("update")( interpreter->mainDict );
+
+        sys.attr("path") = python::list( interpreter->path );
+        sys.attr("meta_path") = python::list( interpreter->metaPath );
+        sys.attr("path_hooks") = python::list( interpreter->pathHooks );
+        sys.attr("path_importer_cache") = python::dict( interpreter->pathImporterCache );
+        sys.attr("argv") = python::list( interpreter->argv );
+
+        pykd::BreakpointRegistry::get().removeInterpreterBreakpoints( interpreter->state->interp );
+
+        // handlers kept in reference cycles are released by the collector
+        python::import("gc").attr("collect")();
+
+        return pykd::getPythonCallbackCount( interpreter->state->interp ) == 0;
+    }
+    catch( const python::error_already_set& )
+    {
+        PyErr_Clear();
+    }
+    catch( const kdlib::DbgException& )
+    {}
+
+    return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void PykdExt::destroyLocalInterpreter( LocalInterpreter *interpreter )
+{
+    PyInterpreterState  *interpreterState = interpreter->state->interp;
+
+    // the registry outlives the interpreter, its callbacks must not
+    try {
+        pykd::BreakpointRegistry::get().removeInterpreterBreakpoints( interpreterState );
+    }
+    catch( const python::error_already_set& )
+    {
+        PyErr_Clear();
+    }
+    catch( const kdlib::DbgException& )
+    {}
+
+    // the snapshot belongs to the interpreter, it must go first
+    delete interpreter;
+
+    PyInterpreterState_Clear(interpreterState);
+
+    PyInterpreterState_Delete(interpreterState);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -262,6 +474,10 @@ void PykdExt::startConsole()
 
     python::object       global(main.attr("__dict__"));
 
+    pykd::setDbgOutLineBuffered(true);
+
+    pykd::resetCancel();
+
     try {
         PykdInterruptWatch  interruptWatch;
         python::exec(  "__import__('code').InteractiveConsole(__import__('__main__').__dict__).interact()\n", global );
@@ -270,6 +486,8 @@ void PykdExt::startConsole()
     {
         pykd::printException();
     }
+
+    pykd::setDbgOutLineBuffered(false);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -350,6 +568,9 @@ std::string PykdExt::findScript( const std::string &fullFileName )
 
 bool PykdInterruptWatch::onInterrupt()
 {
+    // native loops do not wait for the GIL and the pending call
+    pykd::requestCancel();
+
     HANDLE  quitEvent = CreateEvent( NULL, FALSE, FALSE, NULL );
     PyGILState_STATE state = PyGILState_Ensure();
     Py_AddPendingCall(&quit, (void*)quitEvent);
@@ -364,6 +585,11 @@ bool PykdInterruptWatch::onInterrupt()
 int PykdInterruptWatch::quit(void *context)
 {
     HANDLE   quitEvent = (HANDLE)context;
+
+    // the interrupt is delivered here unless a native loop has taken it already
+    pykd::resetCancel();
+
+    pykd::flushDbgOut();
     kdlib::eprintln( L"User Interrupt: CTRL+BREAK");
     PyErr_SetString( PyExc_SystemExit, "CTRL+BREAK" );
     SetEvent(quitEvent);
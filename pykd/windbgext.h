@@ -1,6 +1,12 @@
 #pragma once
 
+#include <map>
 #include <string>
+#include <vector>
+
+#include <boost/python/dict.hpp>
+#include <boost/python/list.hpp>
+namespace python = boost::python;
 
 #include "kdlib/windbg.h"
 
@@ -27,9 +33,40 @@ private:
     std::string getScriptFileName( const std::string &scriptName );
     std::string findScript( const std::string &fullFileName );
 
+    void execScript( const std::string &scriptFileName, python::object &global );
+
+    // marshaled code is not bound to an interpreter, so it is shared by all of them
+    struct CompiledScript {
+        unsigned long long  writeTime;
+        unsigned long long  size;
+        std::string  code;
+    };
+
+    std::map<std::string, CompiledScript>  m_scriptCache;
+
+    // sub-interpreter for the local mode with pykd already imported and
+    // the state to reset it to after a script run
+    struct LocalInterpreter {
+        PyThreadState  *state;
+        python::dict  mainDict;
+        python::dict  modules;
+        python::list  path;
+        python::list  metaPath;
+        python::list  pathHooks;
+        python::dict  pathImporterCache;
+        python::list  argv;
+    };
+
+    LocalInterpreter* acquireLocalInterpreter();
+    void releaseLocalInterpreter( LocalInterpreter *interpreter );
+    bool resetLocalInterpreter( LocalInterpreter *interpreter );
+    void destroyLocalInterpreter( LocalInterpreter *interpreter );
+
     std::vector<std::string> m_paths;
 
     PyThreadState  *m_pyState;
+
+    std::vector<LocalInterpreter*>  m_localInterpreters;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
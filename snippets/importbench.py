@@ -0,0 +1,53 @@
+#
+# pykd import benchmark: time of 'import pykd' in fresh processes and
+# the module registration phases
+#
+# usage: python importbench.py [runs]
+#
+
+import sys
+import subprocess
+import time
+
+def measureImport(runs):
+    times = []
+    for i in range(runs):
+        start = time.perf_counter()
+        subprocess.check_call( [ sys.executable, "-c", "import pykd" ] )
+        times.append( time.perf_counter() - start )
+    return times
+
+def measureInterpreter(runs):
+    times = []
+    for i in range(runs):
+        start = time.perf_counter()
+        subprocess.check_call( [ sys.executable, "-c", "pass" ] )
+        times.append( time.perf_counter() - start )
+    return times
+
+def printProfile():
+    import pykd
+    profile = pykd.getImportProfile()
+    total = sum( seconds for phase, seconds in profile )
+    print( "registration: %.2f ms" % ( total * 1000 ) )
+    for phase, seconds in profile:
+        print( "  %-32s %8.2f ms %5.1f%%" % ( phase, seconds * 1000, seconds * 100 / total if total else 0 ) )
+
+def main():
+    runs = int(sys.argv[1]) if len(sys.argv) > 1 else 20
+
+    importTimes = sorted( measureImport(runs) )
+    baseTimes = sorted( measureInterpreter(runs) )
+
+    importMedian = importTimes[ runs // 2 ]
+    baseMedian = baseTimes[ runs // 2 ]
+
+    print( "runs: %d" % runs )
+    print( "python startup:           %8.2f ms" % ( baseMedian * 1000 ) )
+    print( "python startup + import:  %8.2f ms" % ( importMedian * 1000 ) )
+    print( "import pykd:              %8.2f ms" % ( ( importMedian - baseMedian ) * 1000 ) )
+
+    printProfile()
+
+if __name__ == "__main__":
+    main()
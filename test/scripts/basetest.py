@@ -137,3 +137,18 @@ class BaseTest( unittest.TestCase ):
         self.assertTrue( hasattr(pykd, 'eventHandler' ) )
         self.assertTrue( hasattr(pykd, 'module') )
         self.assertTrue( hasattr(pykd, 'stackFrame') )
+
+    def testImportProfile( self ):
+        profile = pykd.getImportProfile()
+        self.assertNotEqual( [], profile )
+        self.assertTrue( all( seconds >= 0 for phase, seconds in profile ) )
+
+    def testDeferredClass( self ):
+        capture = pykd.startOutputCapture()
+        self.assertTrue( hasattr(pykd, 'outputCapture') )
+        self.assertTrue( isinstance( capture, pykd.outputCapture ) )
+
+    def testLazyDoc( self ):
+        self.assertTrue( "Start capturing debugger output" in pykd.startOutputCapture.__doc__ )
+        self.assertTrue( "Set software breakpoint" in pykd.setBp.__doc__ )
+        self.assertTrue( "Set hardware breakpoint" in pykd.setBp.__doc__ )
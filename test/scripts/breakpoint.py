@@ -1,6 +1,7 @@
 """ breakpoints """
 
 import unittest
+import struct
 import pykd
 import target
 import testutils
@@ -94,6 +95,27 @@ class BreakpointTest( unittest.TestCase ):
         self.assertEqual( pykd.executionStatus.Break, pykd.go() )
         self.assertEqual( 1, handler.count )
 
+    def testBreakpointNoOverride(self):
+
+        class OutputOnlyHandler( pykd.eventHandler ):
+
+            def __init__(self):
+                super(OutputOnlyHandler, self).__init__()
+                self.count = 0
+
+            def onDebugOutput(self, text, mask):
+                self.count += 1
+
+        handler = OutputOnlyHandler()
+        bp = pykd.setBp( self.targetModule.CdeclFunc )
+        self.assertEqual( pykd.executionStatus.Break, pykd.go() )
+        self.assertEqual( self.targetModule.CdeclFunc, pykd.getIP() )
+
+        # the handler without onBreakpoint still gets the output events
+        outputCount = handler.count
+        pykd.dbgCommand( ".echo breakpoint without override", suppressOutput = False )
+        self.assertTrue( outputCount < handler.count )
+
     def testBreakpointClass(self):
 
         class MyBreakpoint(pykd.breakpoint):
@@ -138,6 +160,133 @@ class BreakpointTest( unittest.TestCase ):
         self.assertEqual( pykd.executionStatus.NoDebuggee, pykd.go() )
 
 
+    def testNativeConditionFalse(self):
+        breakCount = callCounter(stopOnBreak)
+        bp = pykd.setBp( self.targetModule.CdeclFunc, breakCount, "1 + 1 == 3" )
+        self.assertEqual( pykd.executionStatus.NoDebuggee, pykd.go() )
+        self.assertEqual( 0, breakCount.count )
+
+    def testNativeConditionTrue(self):
+        breakCount = callCounter(stopOnBreak)
+        condition = "%s!CdeclFunc == 0x%x" % ( target.moduleName, self.targetModule.CdeclFunc )
+        bp = pykd.setBp( self.targetModule.CdeclFunc, breakCount, condition )
+        self.assertEqual( condition, bp.getCondition() )
+        self.assertEqual( pykd.executionStatus.Break, pykd.go() )
+        self.assertEqual( 1, breakCount.count )
+
+    def testNativeConditionWithoutCallback(self):
+        bp = pykd.setBp( self.targetModule.CdeclFunc, None, "0" )
+        self.assertEqual( pykd.executionStatus.NoDebuggee, pykd.go() )
+
+    def testNativeConditionShortCircuit(self):
+        breakCount = callCounter(stopOnBreak)
+        bp = pykd.setBp( self.targetModule.CdeclFunc, breakCount, "0 != 0 && poi(0) == 5" )
+        self.assertEqual( pykd.executionStatus.NoDebuggee, pykd.go() )
+        self.assertEqual( 0, breakCount.count )
+
+    def testNativeConditionShortCircuitOr(self):
+        breakCount = callCounter(stopOnBreak)
+        bp = pykd.setBp( self.targetModule.CdeclFunc, breakCount, "1 || poi(0) == 5" )
+        self.assertEqual( pykd.executionStatus.Break, pykd.go() )
+        self.assertEqual( 1, breakCount.count )
+
+    def testNativeConditionSyntax(self):
+        bp = pykd.setBp( self.targetModule.CdeclFunc, lambda : True )
+        self.assertRaises( pykd.DbgException, bp.setCondition, "(1 + " )
+        self.assertRaises( pykd.DbgException, bp.setCondition, "foo(1)" )
+        bp.setCondition( "1 < 2 && !(3 & 4)" )
+        bp.setCondition( "0n16 == 0x10 && 0y11 == 0t3 && 1`0000 == 0n65536" )
+        self.assertRaises( pykd.DbgException, bp.setCondition, "0n1f" )
+        self.assertRaises( pykd.DbgException, bp.setCondition, "1`" )
+        bp.setCondition( "" )
+        self.assertEqual( "", bp.getCondition() )
+
+    def testCountingBp(self):
+        bp = pykd.setCountingBp( self.targetModule.CdeclFunc, 1 )
+        self.assertEqual( pykd.executionStatus.NoDebuggee, pykd.go() )
+        self.assertEqual( 1, bp.getHitCount() )
+        self.assertEqual( 1, sum( bp.getThreadCounts().values() ) )
+        callers = bp.getCallers()
+        self.assertEqual( 1, len(callers) )
+        self.assertEqual( 1, callers[0][1] )
+        bp.reset()
+        self.assertEqual( 0, bp.getHitCount() )
+        self.assertEqual( [], bp.getCallers() )
+
+    def testCountingBpCondition(self):
+        bp = pykd.setCountingBp( self.targetModule.CdeclFunc, 0, "0" )
+        self.assertEqual( pykd.executionStatus.NoDebuggee, pykd.go() )
+        self.assertEqual( 0, bp.getHitCount() )
+        self.assertEqual( [], bp.getCallers() )
+
+    def testTraceBp(self):
+        spec = [ "1 + 2", ( "%s!CdeclFunc" % target.moduleName, 4 ) ]
+        bp = pykd.setTraceBp( self.targetModule.CdeclFunc, spec, 16 )
+        self.assertEqual( 28, bp.getRecordSize() )
+        self.assertEqual( [ "hit", "thread", "1 + 2", spec[1][0] ], [ item[0] for item in bp.getLayout() ] )
+        self.assertEqual( pykd.executionStatus.NoDebuggee, pykd.go() )
+        self.assertEqual( 1, bp.getRecordCount() )
+        records = bp.getRecords()
+        self.assertEqual( bp.getRecordSize(), len(records) )
+        hit, tid, value = struct.unpack_from( "<QQQ", bytes(records) )
+        self.assertEqual( 0, hit )
+        self.assertNotEqual( 0, tid )
+        self.assertEqual( 3, value )
+        bp.reset()
+        self.assertEqual( 0, len( bp.getRecords() ) )
+
+    def testTraceBpSpec(self):
+        self.assertRaises( pykd.DbgException, pykd.setTraceBp, self.targetModule.CdeclFunc, [ "(" ] )
+        self.assertRaises( pykd.DbgException, pykd.setTraceBp, self.targetModule.CdeclFunc, [ "1" ], 0 )
+
+    def testSetBreakpoints(self):
+        hits = []
+        def onHit(bpId):
+            hits.append(bpId)
+            return pykd.eventResult.Proceed
+
+        addresses = [ self.targetModule.CdeclFunc, self.targetModule.CdeclFunc + 1 ]
+        ids = pykd.setBreakpoints( addresses, onHit )
+        self.assertEqual( 2, len(ids) )
+        self.assertEqual( ids, pykd.setBreakpoints( addresses ) )
+        self.assertEqual( ids[1], pykd.findBreakpoint( addresses[1] ) )
+        self.assertEqual( None, pykd.findBreakpoint( addresses[1] + 1 ) )
+        self.assertEqual( 2, len( pykd.getRegisteredBreakpoints() ) )
+
+        pykd.removeBreakpoints( ids[1:] )
+        self.assertEqual( None, pykd.findBreakpoint( addresses[1] ) )
+        self.assertEqual( 1, pykd.getNumberBreakpoints() )
+
+        self.assertEqual( pykd.executionStatus.NoDebuggee, pykd.go() )
+        self.assertEqual( [ ids[0] ], hits )
+
+    def testRegisteredBreakpointRemoveAll(self):
+        ids = pykd.setBreakpoints( [ self.targetModule.CdeclFunc ] )
+        pykd.removeAllBp()
+        self.assertEqual( [], pykd.getRegisteredBreakpoints() )
+        pykd.removeBreakpoints( ids )
+        self.assertEqual( 0, pykd.getNumberBreakpoints() )
+        self.assertEqual( pykd.executionStatus.NoDebuggee, pykd.go() )
+
+    def testCoverage(self):
+        addresses = [ self.targetModule.CdeclFunc, self.targetModule.CdeclFunc ]
+        coverage = pykd.startCoverage( addresses )
+        self.assertEqual( 1, coverage.getAddressCount() )
+        self.assertEqual( 1, pykd.getNumberBreakpoints() )
+        self.assertEqual( pykd.executionStatus.NoDebuggee, pykd.go() )
+        self.assertEqual( 1, coverage.getHitCount() )
+        self.assertEqual( [ self.targetModule.CdeclFunc ], coverage.getHits() )
+        self.assertEqual( [], coverage.getMissed() )
+        self.assertEqual( 0, pykd.getNumberBreakpoints() )
+        self.assertEqual( 1, coverage.getBitmap()[0] )
+        self.assertEqual( 0, struct.unpack( "<I", bytes( coverage.getHitOrder() ) )[0] )
+
+    def testFunctionCoverage(self):
+        coverage = pykd.startFunctionCoverage( self.targetModule )
+        self.assertTrue( self.targetModule.CdeclFunc in coverage.getAddresses() )
+        coverage.stop()
+        self.assertEqual( 0, pykd.getNumberBreakpoints() )
+
     def testBreakpointEnum(self):
 
         b1 = pykd.setBp( self.targetModule.CdeclFunc)
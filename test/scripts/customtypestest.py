@@ -143,3 +143,14 @@ class CustomTypesTest(unittest.TestCase):
         functype.append( "var1", baseTypes.WChar)
         functype.append( "var2", baseTypes.UInt4B.ptrTo() )
         self.assertEqual( "UInt4B(__cdecl)(WChar, UInt4B*)", functype.name() )
+
+    def testBaseTypesInterned(self):
+        for i in range(100):
+            self.assertEqual( "UInt4B", baseTypes.UInt4B.name() )
+            self.assertEqual( "UInt4B*", baseTypes.UInt4B.ptrTo().name() )
+            self.assertEqual( "UInt4B*", baseTypes.UInt4B.ptrTo(pykd.ptrSize()).name() )
+            self.assertEqual( "Char[16]", baseTypes.Char.arrayOf(16).name() )
+            self.assertEqual( "Char*[2]", baseTypes.Char.ptrTo().arrayOf(2).name() )
+        self.assertEqual( pykd.ptrSize(), baseTypes.VoidPtr.size() )
+        self.assertEqual( 8, baseTypes.UInt4B.ptrTo(8).size() )
+        self.assertEqual( 4, baseTypes.UInt4B.ptrTo(4).size() )
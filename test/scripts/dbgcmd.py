@@ -7,6 +7,25 @@ class DbgcmdTest( unittest.TestCase ):
 
     def testDbgCommand( self ):
         self.assertNotEqual( "", pykd.dbgCommand("lm") )
+
+    def testDbgCommandStream( self ):
+        batches = []
+        count = pykd.dbgCommandStream( "lm", lambda lines: batches.append(lines), batchSize = 1 )
+        self.assertNotEqual( 0, count )
+        self.assertEqual( count, len(batches) )
+
+        lines = []
+        pykd.dbgCommandStream( "lm", lambda l: lines.extend(l), "targetapp" )
+        self.assertNotEqual( [], lines )
+        self.assertTrue( all( "targetapp" in line for line in lines ) )
+
+    def testDbgCommandStreamStop( self ):
+        self.assertEqual( 1, pykd.dbgCommandStream( "lm", lambda lines: False, batchSize = 1 ) )
+
+    def testDbgCommandStreamError( self ):
+        def callback(lines):
+            raise ZeroDivisionError()
+        self.assertRaises( ZeroDivisionError, pykd.dbgCommandStream, "lm", callback )
         
 #    def testDbgExt( self ):
 #        #ext = pykd.loadExt( "ext" )
@@ -16,6 +16,27 @@ class OutHandler( pykd.eventHandler ):
         elif mask == pykd.outputFlag.Verbose:
             self.verbose_counter += 1    
 
+class QueuedOutHandler( pykd.eventHandler ):
+
+    def __init__(self):
+        pykd.eventHandler.__init__(self)
+        self.setQueuedMode(True)
+        self.batches = 0
+        self.out_counter = 0
+
+    def onEvents(self, events):
+        self.batches += 1
+        for event in events:
+            if event[0] == "onDebugOutput":
+                self.out_counter += 1
+
+class FailingOutHandler( OutHandler ):
+
+    def onDebugOutput(self, text, mask):
+        OutHandler.onDebugOutput(self, text, mask)
+        if self.out_counter == 1:
+            raise RuntimeError("handler error")
+
 class OutputHandlerTest( unittest.TestCase ):
 
     def setUp(self):
@@ -35,4 +56,56 @@ class OutputHandlerTest( unittest.TestCase ):
         pykd.setOutputMask(pykd.outputFlag.Normal | pykd.outputFlag.Verbose)
         pykd.startProcess( target.appPath )
         self.assertTrue( 0 < self.handler.out_counter)
-        self.assertTrue( 0 < self.handler.verbose_counter)
\ No newline at end of file
+        self.assertTrue( 0 < self.handler.verbose_counter)
+
+    def testQueuedOutput(self):
+        handler = QueuedOutHandler()
+        pykd.startProcess( target.appPath )
+        handler.flushEvents()
+        self.assertTrue( 0 < handler.batches )
+        self.assertTrue( 0 < handler.out_counter )
+
+    def testQueuedSeparateHandlers(self):
+        self.handler.setQueuedMode(True, 4)
+        pykd.startProcess( target.appPath )
+        self.handler.flushEvents()
+        self.assertTrue( 0 < self.handler.out_counter)
+
+    def testQueuedHandlerError(self):
+        handler = FailingOutHandler()
+        handler.setQueuedMode(True)
+        pykd.startProcess( target.appPath )
+        handler.flushEvents()
+        self.assertTrue( 1 < handler.out_counter )
+
+    def testQueuedCapacity(self):
+        self.handler.setQueuedMode(True, 0, 2)
+        pykd.startProcess( target.appPath )
+        self.handler.flushEvents()
+        self.assertTrue( 0 < self.handler.out_counter )
+        self.assertTrue( 0 < self.handler.getDroppedEvents() )
+        self.assertRaises( pykd.DbgException, self.handler.setQueuedMode, True, 0, 0 )
+
+    def testOutputCapture(self):
+        capture = pykd.startOutputCapture()
+        pykd.startProcess( target.appPath )
+        lines = capture.read()
+        self.assertTrue( 0 < len(lines) )
+        timestamp, flag, text = lines[0]
+        self.assertTrue( 0 < timestamp )
+        self.assertFalse( "\n" in text )
+        self.assertEqual( 0, len(capture) )
+
+    def testOutputCaptureFilter(self):
+        capture = pykd.startOutputCapture( "^no such line$", True, 16 )
+        pykd.startProcess( target.appPath )
+        self.assertEqual( [], capture.read() )
+        self.assertRaises( pykd.DbgException, pykd.startOutputCapture, "(", True )
+
+    def testOutputCapturePartialLine(self):
+        capture = pykd.startOutputCapture( "partialLine" )
+        # sys.stdout does not reach the engine output callbacks, the engine prints
+        pykd.dbgCommand( '.printf "partialLine"', suppressOutput = False )
+        lines = capture.read()
+        self.assertEqual( 1, len(lines) )
+        self.assertEqual( "partialLine", lines[0][2] )
\ No newline at end of file
@@ -92,6 +92,18 @@ class ModuleTest( unittest.TestCase ):
         #fileName, lineNo, displacement = pykd.getSourceLine()
         #self.assertEqual( 698, lineNo )
 
+    def testSourceLines( self ):
+        pykd.clearSourceLineCache()
+        lines = pykd.getSourceLines( [ target.module.CdeclFunc + 2, target.module.CdeclFunc + 2, 0 ] )
+        self.assertEqual( 3, len(lines) )
+        self.assertEqual( lines[0], lines[1] )
+        fileName, lineNo = lines[0]
+        self.assertEqual( 30, lineNo )
+        self.assertTrue( re.search('testfunc\\.cpp', fileName ) )
+        self.assertEqual( None, lines[2] )
+        self.assertEqual( [None], pykd.getSourceLines( [ 0 ] ) )
+        self.assertEqual( (fileName, lineNo, 2), pykd.getSourceLine( target.module.CdeclFunc + 2) )
+
     def testEnumSymbols( self ):
         lst = target.module.enumSymbols()
         self.assertNotEqual( 0, len(lst) )
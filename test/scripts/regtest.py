@@ -24,6 +24,29 @@ class CpuRegTest( unittest.TestCase ):
          pykd.setReg( pykd.getRegisterName(2), oldVal )
          self.assertEqual(pykd.reg(2), oldVal )
 
+    def testContextSnapshot(self):
+        snapshot = pykd.getContextSnapshot()
+        self.assertTrue( 0 < len(snapshot) <= pykd.getNumberRegisters() )
+        for name, value in snapshot.items():
+            self.assertEqual( pykd.reg(name), value )
+            self.assertEqual( value, snapshot[name] )
+        name = snapshot.keys()[2]
+        value = snapshot[2]
+        self.assertEqual( value, snapshot[name] )
+        self.assertEqual( snapshot[-1], snapshot.items()[-1][1] )
+        self.assertTrue( name in snapshot )
+        self.assertEqual( value, getattr(snapshot, name) )
+        self.assertRaises( KeyError, lambda: snapshot["notRegister"] )
+
+    def testSetContext(self):
+        snapshot = pykd.getContextSnapshot()
+        name = snapshot.keys()[2]
+        oldVal = snapshot[2]
+        pykd.setContext( { name : 10 } )
+        self.assertEqual( 10, pykd.reg(name) )
+        pykd.setContext( snapshot )
+        self.assertEqual( oldVal, pykd.reg(name) )
+
 
 
     #def testCtor(self):
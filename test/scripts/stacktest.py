@@ -29,6 +29,96 @@ class StackTest(unittest.TestCase):
 
         self.assertEqual( expectedStack, realStack[0:4])
 
+    def testGetStackTable(self):
+        stack = pykd.getStack()
+        table = pykd.getStackTable()
+
+        self.assertEqual( len(stack), len(table) )
+        self.assertEqual( [ frame.ip for frame in stack ], table.ips )
+        self.assertEqual( [ frame.ret for frame in stack ], table.rets )
+        self.assertEqual( [ frame.sp for frame in stack ], table.sps )
+        self.assertEqual( [ frame.fp for frame in stack ], table.fps )
+        self.assertEqual( ( stack[1].ip, stack[1].ret, stack[1].sp, stack[1].fp ), table.getTable()[1] )
+        self.assertEqual( stack[-1].ip, table.getIP(-1) )
+        self.assertEqual( stack[2].ip, table[2].ip )
+        self.assertEqual( [ frame.ip for frame in stack ], [ frame.ip for frame in table ] )
+        self.assertRaises( IndexError, table.getIP, len(table) )
+
+    def testWalkAllStacks(self):
+        currentTid = pykd.getThreadSystemID()
+
+        result = pykd.walkAllStacks()
+        self.assertEqual( result.threadCount, len(result.tids) )
+        self.assertEqual( result.frameCount, len(result.ips) )
+        self.assertTrue( currentTid in result.tids )
+        self.assertEqual( currentTid, pykd.getThreadSystemID() )
+
+        threadIndex = result.tids.index(currentTid)
+        stack = result.getStack(threadIndex)
+        self.assertEqual( [ frame.ip for frame in pykd.getStack() ], [ ip for ip, symbol in stack ] )
+        self.assertEqual( pykd.findSymbol( stack[0][0] ), stack[0][1] )
+
+        filtered = pykd.walkAllStacks( lambda pid, tid: tid == currentTid )
+        self.assertEqual( [currentTid], filtered.tids )
+        self.assertEqual( len(stack), filtered.frameCount )
+
+    def testAggregateStacks(self):
+        result = pykd.walkAllStacks()
+        buckets = pykd.aggregateStacks(result)
+
+        nonEmpty = len( [ size for size in result.stackSizes if size > 0 ] )
+        self.assertEqual( nonEmpty, sum( [ buckets.getCount(i) for i in range(len(buckets)) ] ) )
+        self.assertTrue( len(buckets) <= nonEmpty )
+        self.assertEqual( nonEmpty, buckets.getCallTree()[1] )
+        self.assertTrue( len(pykd.aggregateStacks(result, True)) <= len(buckets) )
+
+        folded = buckets.folded().splitlines()
+        self.assertEqual( nonEmpty, sum( [ int(line.rsplit(' ', 1)[1]) for line in folded ] ) )
+        self.assertTrue( [ line for line in folded if 'stackTestRun2;' in line ] )
+
+    def testScanStack(self):
+        stack = pykd.getStack()
+        begin = pykd.getSP()
+        end = stack[3].sp
+
+        pointers = pykd.scanStack( begin, end )
+        values = [ value for offset, value, symbol in pointers ]
+        for frame in stack[0:3]:
+            self.assertTrue( frame.ret in values )
+
+        retAddresses = [ value for offset, value, symbol in pykd.scanStack( begin, end, True ) ]
+        self.assertTrue( len(retAddresses) <= len(values) )
+        for frame in stack[0:3]:
+            self.assertTrue( frame.ret in retAddresses )
+
+        offset, value, symbol = pointers[0]
+        self.assertEqual( value, pykd.ptrPtr(offset) )
+        self.assertEqual( pykd.findSymbol(value), symbol )
+
+        self.assertRaises( pykd.DbgException, pykd.scanStack, begin, begin + 0x100000000 )
+
+    def testCancel(self):
+        stack = pykd.getStack()
+        try:
+            pykd.cancelScript()
+            self.assertTrue( pykd.isCancelRequested() )
+            self.assertRaises( KeyboardInterrupt, pykd.checkCancel )
+            self.assertFalse( pykd.isCancelRequested() )
+            pykd.checkCancel()
+            pykd.cancelScript()
+            self.assertRaises( KeyboardInterrupt, pykd.setProgress, 1, 2 )
+            pykd.cancelScript()
+            self.assertRaises( KeyboardInterrupt, pykd.walkAllStacks )
+            pykd.cancelScript()
+            self.assertRaises( KeyboardInterrupt, pykd.scanStack, stack[0].sp, stack[3].sp )
+            self.assertFalse( pykd.isCancelRequested() )
+            pykd.cancelScript()
+        finally:
+            pykd.resetCancel()
+        self.assertFalse( pykd.isCancelRequested() )
+        pykd.checkCancel()
+        pykd.setProgress( 1, 2, "test" )
+
     def testGetParams(self):
 
         frame0 = pykd.getFrame()
@@ -49,6 +139,36 @@ class StackTest(unittest.TestCase):
         self.assertEqual( expectedLocals, [name for name, param in frame2.getLocals() ] )
         self.assertEqual( 0.0, frame2.locals["localDouble"] )
 
+    def testLazyFrameVars(self):
+        frame1 = pykd.getStack()[1]
+
+        params = frame1.params
+        self.assertEqual( ["a", "b", "c"], params.keys() )
+        self.assertEqual( ["a", "b", "c"], frame1.getParams().names() )
+        self.assertEqual( ["a", "b", "c"], [ name for name in params ] )
+        self.assertTrue( "a" in params )
+        self.assertFalse( "notExist" in params )
+        self.assertEqual( None, params.get("notExist") )
+        self.assertEqual( 10, params.get("a") )
+        self.assertRaises( KeyError, lambda: params["notExist"] )
+        self.assertEqual( "c", frame1.getParams()[-1][0] )
+        self.assertRaises( IndexError, lambda: frame1.getParams()[3] )
+
+        paramsList = frame1.getParams()
+        self.assertEqual( ["a", "b", "c"], [ name for name, value in paramsList ] )
+        self.assertEqual( ["b", "c"], [ name for name, value in paramsList[1:] ] )
+        self.assertEqual( ["c", "a"], [ name for name, value in paramsList[::-2] ] )
+        self.assertEqual( paramsList.items(), paramsList )
+        self.assertEqual( 10, paramsList.values()[0] )
+        self.assertEqual( dict(params.items()), params )
+        self.assertEqual( params, frame1.params )
+        self.assertTrue( repr(params).startswith("{") )
+        self.assertTrue( str(paramsList).startswith("[") )
+
+        frame2 = pykd.getStack()[2]
+        self.assertEqual( ["localDouble", "localFloat", "localChars"], frame2.locals.keys() )
+        self.assertEqual( len(frame2.getLocals()), len(frame2.locals) )
+
     def testGetParamsNoSymbol(self):
         topFrame = pykd.getStack()[-1]
         self.assertEqual(0, len(topFrame.getParams()))
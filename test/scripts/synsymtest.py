@@ -1,5 +1,7 @@
 """Synthetic symbols tests"""
 
+import os
+import tempfile
 import unittest
 import target
 import pykd
@@ -40,3 +42,38 @@ class SynSymTest(unittest.TestCase):
 
         pykd.removeSyntheticModule(base + 1024)
         pykd.removeSyntheticModule(base)
+
+    def testBulkAdd(self):
+        """Add synthetic symbols from the table"""
+        base = 128 * 1024
+
+        pykd.addSyntheticModule(base, 1024, "artificial_module3")
+
+        table = [ (0x10 * i, 0x10, "bulkSym%d" % i) for i in range(16) ]
+        self.assertEqual(16, pykd.addSyntheticSymbols(base, table))
+        self.assertEqual(0, pykd.addSyntheticSymbols(base, table[:2]))
+
+        self.assertEqual(("artificial_module3", "bulkSym3", 4), pykd.findSyntheticSymbol(base + 0x34))
+        self.assertEqual("artificial_module3!bulkSym3+4", pykd.findSymbol(base + 0x34))
+        self.assertEqual(None, pykd.findSyntheticSymbol(base + 0x100))
+
+        pykd.removeSyntheticModule(base)
+        self.assertEqual(None, pykd.findSyntheticSymbol(base + 0x34))
+
+    def testLoadPerfMap(self):
+        """Add synthetic symbols from the perf map file"""
+        base = 192 * 1024
+
+        pykd.addSyntheticModule(base, 1024, "artificial_module4")
+
+        fileName = os.path.join(tempfile.gettempdir(), "pykd_perf_map.txt")
+        with open(fileName, "w") as mapFile:
+            mapFile.write("%x 20 jitted::func1\n" % base)
+            mapFile.write("%x 10 jitted::func2(int, char)\n" % (base + 0x20))
+
+        try:
+            self.assertEqual(2, pykd.loadSyntheticSymbols(fileName))
+            self.assertEqual(("artificial_module4", "jitted::func2(int, char)", 1), pykd.findSyntheticSymbol(base + 0x21))
+        finally:
+            os.remove(fileName)
+            pykd.removeSyntheticModule(base)
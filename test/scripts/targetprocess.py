@@ -34,6 +34,25 @@ class ProcessTest(unittest.TestCase):
             self.assertNotEqual(0, proc.systemID)
             self.assertNotEqual(0, proc.peb)
 
+    def testProcessTable(self):
+        table = pykd.targetSystem.getCurrent().processTable()
+        self.assertEqual( pykd.targetProcess.getNumber(), len(table) )
+        for i in range(len(table)):
+            proc = pykd.targetProcess(i)
+            self.assertEqual( proc.systemID, table[i]["systemID"] )
+            self.assertEqual( proc.peb, table[i]["peb"] )
+            self.assertEqual( proc.getNumberThreads(), len(table[i]["threads"]) )
+
+    def testThreadTable(self):
+        proc = pykd.targetProcess.getCurrent()
+        table = proc.threadTable()
+        self.assertEqual( proc.getNumberThreads(), len(table) )
+        for i in range(len(table)):
+            thread = proc.getThread(i)
+            self.assertEqual( thread.systemID, table[i]["systemID"] )
+            self.assertEqual( thread.teb, table[i]["teb"] )
+            self.assertEqual( thread.ip, table[i]["ip"] )
+
     def testSetCurrentThread(self):
         proc = pykd.targetProcess.getCurrent()
         threadNumber = proc.getNumberThreads()
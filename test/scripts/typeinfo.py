@@ -412,3 +412,30 @@ class TypeInfoTest( unittest.TestCase ):
 
         (typesProvider, outMsg) = pykd.getTypeInfoProviderFromSourceEx('1; abc; ', "-w")
         self.assertTrue ('abc' in outMsg)
+
+    def testClangCompileCache(self):
+        pykd.clearSourceCache()
+        typesProvider1 = pykd.getTypeInfoProviderFromSource(typesSourceCode)
+        typesProvider2 = pykd.getTypeInfoProviderFromSource(typesSourceCode)
+        self.assertTrue(typesProvider1 is typesProvider2)
+        self.assertEqual(typesProvider1.getTypeByName('_LIST_ENTRY').size(), typesProvider2.getTypeByName('_LIST_ENTRY').size())
+        self.assertEqual('_LIST_ENTRY', pykd.getTypeFromSource(typesSourceCode, '_LIST_ENTRY').name())
+
+        (typesProvider, outMsg) = pykd.getTypeInfoProviderFromSourceEx('1; abc; ', "-w")
+        (typesProviderCached, outMsgCached) = pykd.getTypeInfoProviderFromSourceEx('1; abc; ', "-w")
+        self.assertTrue(typesProvider is typesProviderCached)
+        self.assertEqual(outMsg, outMsgCached)
+
+        pykd.clearSourceCache()
+        typesProvider3 = pykd.getTypeInfoProviderFromSource(typesSourceCode)
+        self.assertFalse(typesProvider3 is typesProvider1)
+
+        pykd.setSourceCacheSize(0)
+        try:
+            typesProvider4 = pykd.getTypeInfoProviderFromSource(typesSourceCode)
+            typesProvider5 = pykd.getTypeInfoProviderFromSource(typesSourceCode)
+            self.assertFalse(typesProvider4 is typesProvider3)
+            self.assertFalse(typesProvider4 is typesProvider5)
+            self.assertEqual('_LIST_ENTRY', pykd.getTypeFromSource(typesSourceCode, '_LIST_ENTRY').name())
+        finally:
+            pykd.setSourceCacheSize(16)